@@ -63,6 +63,21 @@ local function ctlsub(c)
 end
 
 -- Return one bytecode line.
+-- Show the case table of a SWITCH as key=>target pairs in case order.
+local function switchcases(t, pc)
+  local cases = {}
+  for k, v in pairs(t) do cases[#cases+1] = { v, k } end
+  table.sort(cases, function(x, y) return x[1] < y[1] end)
+  for i=1,#cases do
+    local k = cases[i][2]
+    if type(k) == "string" then
+      k = format(#k > 10 and '"%.10s"~' or '"%s"', gsub(k, "%c", ctlsub))
+    end
+    cases[i] = format("%s=>%04d", k, pc+1+cases[i][1])
+  end
+  return table.concat(cases, " ")
+end
+
 local function bcline(func, pc, prefix)
   local ins, m = funcbc(func, pc)
   if not ins then return end
@@ -97,6 +112,8 @@ local function bcline(func, pc, prefix)
     end
   elseif mc == 5*128 then -- BCMuv
     kc = funcuvname(func, d)
+  elseif op == "SWITCH" then
+    kc = switchcases(funck(func, -d-1), pc)
   end
   if ma == 5 then -- BCMuv
     local ka = funcuvname(func, a)
@@ -17,11 +17,15 @@ local bit = require("bit")
 -- Symbol name prefix for LuaJIT bytecode.
 local LJBC_PREFIX = "luaJIT_BC_"
 
+-- Symbol name for an embedded module bundle.
+local LJBUNDLE_SYM = "luaJIT_BUNDLE"
+
 ------------------------------------------------------------------------------
 
 local function usage()
   io.stderr:write[[
 Save LuaJIT bytecode: luajit -b[options] input output
+       or a module bundle: luajit -b -B [options] input... output
   -l        Only list bytecode.
   -s        Strip debug info (default).
   -g        Keep debug info.
@@ -30,6 +34,8 @@ Save LuaJIT bytecode: luajit -b[options] input output
   -a arch   Override architecture for object files (default: native).
   -o os     Override OS for object files (default: native).
   -e chunk  Use chunk string as input.
+  -B        Save all inputs as one module bundle. Module names are derived
+            from the input paths, or given as name=input.
   --        Stop handling options.
   -         Use stdin as input and/or stdout as output.
 
@@ -126,12 +132,12 @@ extern "C"
 __declspec(dllexport)
 #endif
 const char %s%s[] = {
-]], LJBC_PREFIX, ctx.modname))
+]], ctx.prefix, ctx.modname))
   else
     fp:write(string.format([[
 #define %s%s_SIZE %d
 static const char %s%s[] = {
-]], LJBC_PREFIX, ctx.modname, #s, LJBC_PREFIX, ctx.modname))
+]], ctx.prefix, ctx.modname, #s, ctx.prefix, ctx.modname))
   end
   local t, n, m = {}, 0, 0
   for i=1,#s do
@@ -198,7 +204,7 @@ typedef struct {
   uint8_t space[4096];
 } ELF64obj;
 ]]
-  local symname = LJBC_PREFIX..ctx.modname
+  local symname = ctx.prefix..ctx.modname
   local is64, isbe = false, false
   if ctx.arch == "x64" then
     is64 = true
@@ -335,7 +341,7 @@ typedef struct {
   uint8_t space[4096];
 } PEobj;
 ]]
-  local symname = LJBC_PREFIX..ctx.modname
+  local symname = ctx.prefix..ctx.modname
   local is64 = false
   if ctx.arch == "x86" then
     symname = "_"..symname
@@ -488,7 +494,7 @@ typedef struct {
   uint8_t space[4096];
 } mach_fat_obj;
 ]]
-  local symname = '_'..LJBC_PREFIX..ctx.modname
+  local symname = '_'..ctx.prefix..ctx.modname
   local isfat, is64, align, mobj = false, false, 4, "mach_obj"
   if ctx.arch == "x64" then
     is64, align, mobj = true, 8, "mach_obj_64"
@@ -573,14 +579,59 @@ end
 
 ------------------------------------------------------------------------------
 
+local function bundlename(input)
+  local name, file = string.match(input, "^([%w_.%-]+)=(.+)$")
+  if name then return name, file end
+  name = string.gsub(input, "^%.[/\\]", "")
+  name = string.gsub(name, "%.[^./\\]*$", "")
+  name = string.gsub(name, "[/\\]", ".")
+  name = string.gsub(name, "%.init$", "")
+  check(string.match(name, "^[%w_.%-]+$"),
+	"cannot derive module name from ", input, ", use name=", input)
+  return name, input
+end
+
+local function u32le(x)
+  local band, shr = bit.band, bit.rshift
+  return string.char(band(x, 255), band(shr(x, 8), 255),
+		     band(shr(x, 16), 255), shr(x, 24))
+end
+
+-- Bundle layout: "LJBN", count, index sorted by name, names and bytecode.
+-- Each index entry holds name offset/length and bytecode offset/length.
+local function bundle(ctx, inputs)
+  local mods, seen = {}, {}
+  for _, input in ipairs(inputs) do
+    check(type(input) == "string", "cannot bundle a chunk string")
+    local name, file = bundlename(input)
+    check(not seen[name], "duplicate module name ", name)
+    seen[name] = true
+    mods[#mods+1] = { name = name, s = string.dump(readfile(file), ctx.strip) }
+  end
+  table.sort(mods, function(a, b) return a.name < b.name end)
+  local idx, data = {}, {}
+  local ofs = 8 + 16*#mods
+  for i, m in ipairs(mods) do
+    idx[i] = u32le(ofs)..u32le(#m.name)..u32le(ofs+#m.name)..u32le(#m.s)
+    data[i] = m.name..m.s
+    ofs = ofs + #data[i]
+  end
+  return "LJBN"..u32le(#mods)..table.concat(idx)..table.concat(data)
+end
+
 local function bclist(input, output)
   local f = readfile(input)
   require("jit.bc").dump(f, savefile(output, "w"), true)
 end
 
 local function bcsave(ctx, input, output)
-  local f = readfile(input)
-  local s = string.dump(f, ctx.strip)
+  local s
+  if ctx.bundle then
+    s = bundle(ctx, input)
+    ctx.prefix, ctx.modname = LJBUNDLE_SYM, ""
+  else
+    s = string.dump(readfile(input), ctx.strip)
+  end
   local t = ctx.type
   if not t then
     t = detecttype(output)
@@ -604,7 +655,7 @@ local function docmd(...)
   local list = false
   local ctx = {
     strip = true, arch = jit.arch, os = string.lower(jit.os),
-    type = false, modname = false,
+    type = false, modname = false, prefix = LJBC_PREFIX, bundle = false,
   }
   while n <= #arg do
     local a = arg[n]
@@ -619,6 +670,8 @@ local function docmd(...)
 	  ctx.strip = true
 	elseif opt == "g" then
 	  ctx.strip = false
+	elseif opt == "B" then
+	  ctx.bundle = true
 	else
 	  if arg[n] == nil or m ~= #a then usage() end
 	  if opt == "e" then
@@ -644,6 +697,10 @@ local function docmd(...)
   if list then
     if #arg == 0 or #arg > 2 then usage() end
     bclist(arg[1], arg[2] or "-")
+  elseif ctx.bundle then
+    if #arg < 2 or ctx.modname then usage() end
+    local output = table.remove(arg)
+    bcsave(ctx, arg, output)
   else
     if #arg ~= 2 then usage() end
     bcsave(ctx, arg[1], arg[2])
@@ -98,6 +98,31 @@ static int32_t ffi_checkint(lua_State *L, int narg)
   return i;
 }
 
+/* Convert argument to a non-negative element count. */
+static MSize ffi_checkcount(lua_State *L, int narg)
+{
+  int32_t n = ffi_checkint(L, narg);
+  if (n < 0)
+    lj_err_arg(L, narg, LJ_ERR_IDXRNG);
+  return (MSize)n;
+}
+
+/* Get number element type of a pointer or array argument. */
+static CType *ffi_checkelem(lua_State *L, int narg)
+{
+  CTState *cts = ctype_cts(L);
+  CType *ct = ctype_raw(cts, ffi_checkcdata(L, narg)->ctypeid);
+  if (ctype_isref(ct->info))
+    ct = ctype_rawchild(cts, ct);
+  if (ctype_isptr(ct->info) || ctype_isarray(ct->info)) {
+    ct = ctype_rawchild(cts, ct);
+    if (ctype_isnum(ct->info))
+      return ct;
+  }
+  lj_err_arg(L, narg, LJ_ERR_FFI_INVTYPE);
+  return NULL;  /* unreachable */
+}
+
 /* -- C type metamethods -------------------------------------------------- */
 
 #define LJLIB_MODULE_ffi_meta
@@ -514,15 +539,8 @@ LJLIB_CF(ffi_new)	LJLIB_REC(.)
   if (ctype_isstruct(ct->info)) {
     /* Handle ctype __gc metamethod. Use the fast lookup here. */
     cTValue *tv = lj_tab_getinth(cts->miscmap, -(int32_t)id);
-    if (tv && tvistab(tv) && (tv = lj_meta_fast(L, tabV(tv), MM_gc))) {
-      GCtab *t = cts->finalizer;
-      if (gcref(t->metatable)) {
-	/* Add to finalizer table, if still enabled. */
-	copyTV(L, lj_tab_set(L, t, o-1), tv);
-	lj_gc_anybarriert(L, t);
-	cd->marked |= LJ_GC_CDATA_FIN;
-      }
-    }
+    if (tv && tvistab(tv) && lj_meta_fast(L, tabV(tv), MM_gc))
+      lj_cdata_setmetafin(L, cd);
   }
   L->top = o;  /* Only return the cdata itself. */
   lj_gc_check(L);
@@ -673,6 +691,19 @@ LJLIB_CF(ffi_string)	LJLIB_REC(.)
   return 1;
 }
 
+LJLIB_CF(ffi_find)	LJLIB_REC(.)
+{
+  const char *p = (const char *)ffi_checkptr(L, 1, CTID_P_CVOID);
+  MSize len = ffi_checkcount(L, 2);
+  GCstr *s = lj_lib_checkstr(L, 3);
+  const char *q = lj_str_find(p, strdata(s), len, s->len);
+  if (q)
+    setintV(L->top-1, (int32_t)(q-p));
+  else
+    setnilV(L->top-1);
+  return 1;
+}
+
 LJLIB_CF(ffi_copy)	LJLIB_REC(.)
 {
   void *dp = ffi_checkptr(L, 1, CTID_P_VOID);
@@ -697,6 +728,43 @@ LJLIB_CF(ffi_fill)	LJLIB_REC(.)
   return 0;
 }
 
+LJLIB_CF(ffi_fromtable)	LJLIB_REC(.)
+{
+  CType *ct = ffi_checkelem(L, 1);
+  uint8_t *dp = (uint8_t *)ffi_checkptr(L, 1, CTID_P_VOID);
+  GCtab *t = lj_lib_checktab(L, 2);
+  MSize n, i;
+  if (L->base+2 < L->top && !tvisnil(L->base+2))
+    n = ffi_checkcount(L, 3);
+  else
+    n = lj_tab_len(t);
+  i = lj_cconv_fromtab(L, dp, t, n, ctype_typeid(ctype_cts(L), ct));
+  if (i < n) {
+    cTValue *tv = lj_tab_getint(t, (int32_t)(i+1));
+    lj_err_callerv(L, LJ_ERR_FFI_TABVAL, lj_typename(tv ? tv : niltv(L)),
+		   (int32_t)(i+1));
+  }
+  return 0;
+}
+
+LJLIB_CF(ffi_totable)
+{
+  CType *ct = ffi_checkelem(L, 1);
+  uint8_t *sp = (uint8_t *)ffi_checkptr(L, 1, CTID_P_CVOID);
+  MSize n = ffi_checkcount(L, 2);
+  GCtab *t;
+  if (L->base+2 < L->top && !tvisnil(L->base+2)) {
+    t = lj_lib_checktab(L, 3);
+    L->top = L->base+3;
+  } else {
+    t = lj_tab_new(L, n+1, 0);
+    settabV(L, L->top++, t);
+  }
+  lj_cconv_totab(ctype_cts(L), ct, sp, t, n);
+  lj_gc_check(L);
+  return 1;
+}
+
 #define H_(le, be)	LJ_ENDIAN_SELECT(0x##le, 0x##be)
 
 /* Test ABI string. */
@@ -791,7 +859,8 @@ LJLIB_CF(ffi_load)
 {
   GCstr *name = lj_lib_checkstr(L, 1);
   int global = (L->base+1 < L->top && tvistruecond(L->base+1));
-  lj_clib_load(L, tabref(curr_func(L)->c.env), name, global);
+  int now = (L->base+2 < L->top && tvistruecond(L->base+2));
+  lj_clib_load(L, tabref(curr_func(L)->c.env), name, global, now);
   return 1;
 }
 
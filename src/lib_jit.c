@@ -20,9 +20,13 @@
 #if LJ_HASJIT
 #include "lj_ir.h"
 #include "lj_jit.h"
+#if LJ_HASFFI
+#include "lj_ctype.h"
+#endif
 #include "lj_ircall.h"
 #include "lj_iropt.h"
 #include "lj_target.h"
+#include "lj_snap.h"
 #endif
 #include "lj_dispatch.h"
 #include "lj_vm.h"
@@ -136,6 +140,32 @@ LJLIB_CF(jit_attach)
   return 0;
 }
 
+static int writer_image(lua_State *L, const void *p, size_t size, void *b)
+{
+  luaL_addlstring((luaL_Buffer *)b, (const char *)p, size);
+  UNUSED(L);
+  return 0;
+}
+
+LJLIB_CF(jit_dumpimage)
+{
+  luaL_Buffer b;
+  L->top = L->base;
+  luaL_buffinit(L, &b);
+  if (luaJIT_dumpimage(L, writer_image, &b))
+    lua_error(L);
+  luaL_pushresult(&b);
+  return 1;
+}
+
+LJLIB_CF(jit_loadimage)
+{
+  GCstr *s = lj_lib_checkstr(L, 1);
+  if (luaJIT_loadimage(L, strdata(s), s->len))
+    lua_error(L);
+  return 0;
+}
+
 LJLIB_PUSH(top-5) LJLIB_SET(os)
 LJLIB_PUSH(top-4) LJLIB_SET(arch)
 LJLIB_PUSH(top-3) LJLIB_SET(version_num)
@@ -333,6 +363,9 @@ LJLIB_CF(jit_util_tracek)
       slot = ir->op2;
       ir = &T->ir[ir->op1];
     }
+#if LJ_HASFFI
+    if (ir->o == IR_KINT64) ctype_loadffi(L);
+#endif
     lj_ir_kvalue(L, L->top-2, ir);
     setintV(L->top-1, (int32_t)irt_type(ir->t));
     if (slot == -1)
@@ -350,7 +383,8 @@ LJLIB_CF(jit_util_tracesnap)
   SnapNo sn = (SnapNo)lj_lib_checkint(L, 2);
   if (T && sn < T->nsnap) {
     SnapShot *snap = &T->snap[sn];
-    SnapEntry *map = &T->snapmap[snap->mapofs];
+    SnapEntry buf[SNAP_MAXMAP];
+    SnapEntry *map = lj_snap_map(T, snap, buf);
     MSize n, nent = snap->nent;
     GCtab *t;
     lua_createtable(L, nent+2, 0);
@@ -13,6 +13,13 @@
 #include "lualib.h"
 
 #include "lj_obj.h"
+#include "lj_gc.h"
+#include "lj_err.h"
+#include "lj_tab.h"
+#if LJ_HASFFI
+#include "lj_ctype.h"
+#include "lj_cconv.h"
+#endif
 #include "lj_lib.h"
 #include "lj_vm.h"
 
@@ -108,32 +115,29 @@ LJLIB_PUSH(1e310) LJLIB_SET(huge)
 ** Full-period ME-CF generator with L=64, J=4, k=223, N1=49.
 */
 
-/* PRNG state. */
-struct RandomState {
-  uint64_t gen[4];	/* State of the 4 LFSR generators. */
-  int valid;		/* State is valid. */
-};
-
 /* Union needed for bit-pattern conversion between uint64_t and double. */
 typedef union { uint64_t u64; double d; } U64double;
 
 /* Update generator i and compute a running xor of all states. */
 #define TW223_GEN(i, k, q, s) \
-  z = rs->gen[i]; \
+  z = gen[i]; \
   z = (((z<<q)^z) >> (k-s)) ^ ((z&((uint64_t)(int64_t)-1 << (64-k)))<<s); \
-  r ^= z; rs->gen[i] = z;
+  r ^= z; gen[i] = z;
 
-/* PRNG step function. Returns a double in the range 1.0 <= d < 2.0. */
-LJ_NOINLINE uint64_t LJ_FASTCALL lj_math_random_step(RandomState *rs)
+/* Inlined PRNG step. Returns a double in the range 1.0 <= d < 2.0. */
+static LJ_AINLINE uint64_t random_step(uint64_t *gen)
 {
   uint64_t z, r = 0;
-  TW223_GEN(0, 63, 31, 18)
-  TW223_GEN(1, 58, 19, 28)
-  TW223_GEN(2, 55, 24,  7)
-  TW223_GEN(3, 47, 21,  8)
+  RANDOM_GENDEF(TW223_GEN)
   return (r & U64x(000fffff,ffffffff)) | U64x(3ff00000,00000000);
 }
 
+/* PRNG step function. Returns a double in the range 1.0 <= d < 2.0. */
+LJ_NOINLINE uint64_t LJ_FASTCALL lj_math_random_step(RandomState *rs)
+{
+  return random_step(rs->gen);
+}
+
 /* PRNG initialization function. */
 static void random_init(RandomState *rs, double d)
 {
@@ -205,6 +209,80 @@ LJLIB_CF(math_random)		LJLIB_REC(.)
   return 1;
 }
 
+/* Next number for math.randomfill(). Same as math.random([m [,n]]). */
+static LJ_AINLINE double random_next(uint64_t *gen, int isrange,
+				     double scale, double ofs)
+{
+  U64double u;
+  double d;
+  u.u64 = random_step(gen);
+  d = u.d - 1.0;
+  if (isrange) d = lj_vm_floor(d*scale) + ofs;
+  return d;
+}
+
+/* PRNG bulk fill function. Same sequence as repeated math.random() calls. */
+LJLIB_PUSH(top-2)  /* Upvalue holds userdata with RandomState. */
+LJLIB_CF(math_randomfill)
+{
+  RandomState *rs = (RandomState *)(uddata(udataV(lj_lib_upvalue(L, 1))));
+  TValue *o = lj_lib_checkany(L, 1);
+  int32_t i, n = lj_lib_checkint(L, 2);
+  int isrange = (L->base+2 < L->top);
+  double scale = 0.0, ofs = 1.0;
+  uint64_t gen[4];
+  if (n < 0) lj_err_arg(L, 2, LJ_ERR_IDXRNG);
+  if (isrange) {
+    double r1 = lj_lib_checknum(L, 3);
+    if (L->base+3 < L->top) {
+      scale = lj_lib_checknum(L, 4) - r1 + 1.0;
+      ofs = r1;
+    } else {
+      scale = r1;
+    }
+  }
+  if (LJ_UNLIKELY(!rs->valid)) random_init(rs, 0.0);
+  memcpy(gen, rs->gen, sizeof(gen));  /* Keep the state in registers. */
+  if (tvistab(o)) {
+    GCtab *t = tabV(o);
+    TValue *array;
+    /* Grow the array part to asize = n+1, so t[1..n] don't need lookups. */
+    if (t->asize < (MSize)n+1) lj_tab_reasize(L, t, (uint32_t)n);
+    array = tvref(t->array);
+    for (i = 1; i <= n; i++)
+      setnumV(&array[i], random_next(gen, isrange, scale, ofs));
+#if LJ_HASFFI
+  } else if (tviscdata(o)) {
+    CTState *cts = ctype_cts(L);
+    CType *ct = ctype_raw(cts, cdataV(o)->ctypeid);
+    uint8_t *p;
+    if (ctype_isref(ct->info))
+      ct = ctype_rawchild(cts, ct);
+    if (!(ctype_isptr(ct->info) || ctype_isarray(ct->info)))
+      lj_err_arg(L, 1, LJ_ERR_FFI_INVTYPE);
+    ct = ctype_rawchild(cts, ct);
+    if (!ctype_isnum(ct->info))
+      lj_err_arg(L, 1, LJ_ERR_FFI_INVTYPE);
+    lj_cconv_ct_tv(cts, ctype_get(cts, CTID_P_VOID), (uint8_t *)&p, o,
+		   CCF_ARG(1));
+    if (ctype_isfp(ct->info) && ct->size == sizeof(double)) {
+      for (i = 0; i < n; i++)
+	((double *)p)[i] = random_next(gen, isrange, scale, ofs);
+    } else {
+      for (i = 0; i < n; i++, p += ct->size) {
+	TValue tv;
+	setnumV(&tv, random_next(gen, isrange, scale, ofs));
+	lj_cconv_ct_tv(cts, ct, p, &tv, 0);
+      }
+    }
+#endif
+  } else {
+    lj_err_argt(L, 1, LUA_TTABLE);
+  }
+  memcpy(rs->gen, gen, sizeof(gen));
+  return 0;
+}
+
 /* PRNG seed function. */
 LJLIB_PUSH(top-2)  /* Upvalue holds userdata with RandomState. */
 LJLIB_CF(math_randomseed)
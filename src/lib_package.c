@@ -32,6 +32,9 @@
 #define SYMPREFIX_CF		"luaopen_%s"
 #define SYMPREFIX_BC		"luaJIT_BC_%s"
 
+/* Symbol name of an embedded module bundle. */
+#define SYM_BUNDLE		"luaJIT_BUNDLE"
+
 #if LJ_TARGET_DLOPEN
 
 #include <dlfcn.h>
@@ -273,6 +276,66 @@ static int readable(const char *filename)
   return 1;
 }
 
+#if LJ_TARGET_POSIX && !LJ_TARGET_CONSOLE
+
+#include <dirent.h>
+
+/* Push a table with the names of all entries of a directory. */
+static int ll_listdir(lua_State *L, const char *dir)
+{
+  DIR *d = opendir(*dir ? dir : ".");
+  struct dirent *e;
+  if (d == NULL) return 0;
+  lua_newtable(L);
+  while ((e = readdir(d)) != NULL) {
+    lua_pushboolean(L, 1);
+    lua_setfield(L, -2, e->d_name);
+  }
+  closedir(d);
+  return 1;
+}
+
+/*
+** Check the directory listing cache in package.dircache for a file.
+** It maps directory names (incl. the trailing separator) to a table of
+** entry names, to false for a missing directory or to true to always
+** probe the file system. Missing directories are listed on first use.
+** Returns 0 if the file is known to be absent, 1 otherwise.
+*/
+static int dircache_probe(lua_State *L, int cache, const char *filename)
+{
+  const char *base = filename, *p;
+  int found;
+  for (p = filename; *p; p++)
+    if (*p == *LUA_DIRSEP) base = p+1;
+  lua_pushlstring(L, filename, (size_t)(base - filename));
+  lua_pushvalue(L, -1);
+  lua_rawget(L, cache);
+  if (lua_isnil(L, -1)) {  /* Not listed yet? */
+    lua_pop(L, 1);
+    if (!ll_listdir(L, lua_tostring(L, -1)))
+      lua_pushboolean(L, 0);  /* Missing or unreadable directory. */
+    lua_pushvalue(L, -2);
+    lua_pushvalue(L, -2);
+    lua_rawset(L, cache);
+  }
+  if (lua_istable(L, -1)) {
+    lua_getfield(L, -1, base);
+    found = !lua_isnil(L, -1);
+    lua_pop(L, 3);
+  } else {
+    found = lua_toboolean(L, -1);
+    lua_pop(L, 2);
+  }
+  return found;
+}
+
+#else
+
+#define dircache_probe(L, cache, filename)	1
+
+#endif
+
 static const char *pushnexttemplate(lua_State *L, const char *path)
 {
   const char *l;
@@ -286,7 +349,7 @@ static const char *pushnexttemplate(lua_State *L, const char *path)
 
 static const char *searchpath (lua_State *L, const char *name,
 			       const char *path, const char *sep,
-			       const char *dirsep)
+			       const char *dirsep, int cache)
 {
   luaL_Buffer msg;  /* to build error message */
   luaL_buffinit(L, &msg);
@@ -296,7 +359,8 @@ static const char *searchpath (lua_State *L, const char *name,
     const char *filename = luaL_gsub(L, lua_tostring(L, -1),
 				     LUA_PATH_MARK, name);
     lua_remove(L, -2);  /* remove path template */
-    if (readable(filename))  /* does file exist and is readable? */
+    if ((!cache || dircache_probe(L, cache, filename)) &&
+	readable(filename))  /* does file exist and is readable? */
       return filename;  /* return that file name */
     lua_pushfstring(L, "\n\tno file " LUA_QS, filename);
     lua_remove(L, -2);  /* remove file name */
@@ -311,7 +375,7 @@ static int lj_cf_package_searchpath(lua_State *L)
   const char *f = searchpath(L, luaL_checkstring(L, 1),
 				luaL_checkstring(L, 2),
 				luaL_optstring(L, 3, "."),
-				luaL_optstring(L, 4, LUA_DIRSEP));
+				luaL_optstring(L, 4, LUA_DIRSEP), 0);
   if (f != NULL) {
     return 1;
   } else {  /* error message is on top of the stack */
@@ -325,11 +389,15 @@ static const char *findfile(lua_State *L, const char *name,
 			    const char *pname)
 {
   const char *path;
+  int cache = 0;
+  lua_getfield(L, LUA_ENVIRONINDEX, "dircache");
+  if (lua_istable(L, -1))
+    cache = lua_gettop(L);
   lua_getfield(L, LUA_ENVIRONINDEX, pname);
   path = lua_tostring(L, -1);
   if (path == NULL)
     luaL_error(L, LUA_QL("package.%s") " must be a string", pname);
-  return searchpath(L, name, path, ".", LUA_DIRSEP);
+  return searchpath(L, name, path, ".", LUA_DIRSEP, cache);
 }
 
 static void loaderror(lua_State *L, const char *filename)
@@ -378,6 +446,119 @@ static int lj_cf_package_loader_croot(lua_State *L)
   return 1;
 }
 
+/* ------------------------------------------------------------------------ */
+
+/*
+** A module bundle holds the bytecode of many modules in one block of memory.
+** Layout: "LJBN", number of modules, then an index sorted by module name,
+** with name offset, name length, bytecode offset and bytecode length for
+** each module. All numbers are 32 bit little-endian, all offsets are
+** relative to the start of the bundle. Bundles are created with luajit -b.
+*/
+
+static uint32_t bundle_u32(const uint8_t *p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+	 ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* Check the header and the index of a bundle. */
+static int bundle_check(const uint8_t *b, size_t sz)
+{
+  uint32_t i, n;
+  if (sz < 8 || memcmp(b, "LJBN", 4) != 0) return 0;
+  n = bundle_u32(b+4);
+  if (n > (sz-8)/16) return 0;
+  for (i = 0; i < n; i++) {
+    const uint8_t *e = b + 8 + 16*i;
+    uint32_t nofs = bundle_u32(e), nlen = bundle_u32(e+4);
+    uint32_t dofs = bundle_u32(e+8), dlen = bundle_u32(e+12);
+    if (nofs > sz || nlen > sz-nofs || dofs > sz || dlen > sz-dofs) return 0;
+  }
+  return 1;
+}
+
+/* Find a module in a bundle and load it. Only decodes what's needed. */
+static int bundle_load(lua_State *L, const uint8_t *b, const char *name)
+{
+  size_t len = strlen(name);
+  uint32_t lo = 0, hi = bundle_u32(b+4);
+  while (lo < hi) {  /* Binary search in the sorted index. */
+    uint32_t mid = lo + ((hi - lo) >> 1);
+    const uint8_t *e = b + 8 + 16*mid;
+    uint32_t nlen = bundle_u32(e+4);
+    int cmp = memcmp(name, b + bundle_u32(e), len < nlen ? len : nlen);
+    if (cmp == 0) cmp = len < nlen ? -1 : len > nlen ? 1 : 0;
+    if (cmp == 0) {
+      if (luaL_loadbuffer(L, (const char *)b + bundle_u32(e+8),
+			  bundle_u32(e+12), name) != 0)
+	luaL_error(L, "error loading module " LUA_QS " from bundle:\n\t%s",
+		   name, lua_tostring(L, -1));
+      return 1;
+    }
+    if (cmp < 0) hi = mid; else lo = mid+1;
+  }
+  return 0;
+}
+
+/* Search the embedded bundle and all loaded bundles.
+** The registry table with the loaded bundles is not exposed to Lua code,
+** since it must only hold bundles which passed bundle_check().
+*/
+static int ll_loadbundled(lua_State *L, const char *name)
+{
+  const uint8_t *b = (const uint8_t *)ll_bcsym(NULL, SYM_BUNDLE);
+  int i;
+  if (b && bundle_load(L, b, name))
+    return 1;
+  lua_getfield(L, LUA_REGISTRYINDEX, "_BUNDLES");
+  if (lua_istable(L, -1)) {
+    for (i = 1; ; i++) {
+      lua_rawgeti(L, -1, i);
+      b = (const uint8_t *)lua_touserdata(L, -1);
+      if (b == NULL) break;
+      if (bundle_load(L, b, name)) return 1;
+      lua_pop(L, 1);
+    }
+    lua_pop(L, 1);
+  }
+  lua_pop(L, 1);
+  return 0;
+}
+
+static int lj_cf_package_loadbundle(lua_State *L)
+{
+  const char *filename = luaL_checkstring(L, 1);
+  FILE *fp = fopen(filename, "rb");
+  long sz;
+  void *b;
+  if (fp == NULL) {
+    lua_pushnil(L);
+    lua_pushfstring(L, "cannot open " LUA_QS, filename);
+    return 2;
+  }
+  if (fseek(fp, 0, SEEK_END) != 0 || (sz = ftell(fp)) < 0 ||
+      fseek(fp, 0, SEEK_SET) != 0) {
+    sz = 0;
+  }
+  b = lua_newuserdata(L, (size_t)sz);
+  if (sz == 0 || fread(b, 1, (size_t)sz, fp) != (size_t)sz ||
+      !bundle_check((const uint8_t *)b, (size_t)sz)) {
+    fclose(fp);
+    lua_pushnil(L);
+    lua_pushfstring(L, "bad bundle " LUA_QS, filename);
+    return 2;
+  }
+  fclose(fp);
+  luaL_findtable(L, LUA_REGISTRYINDEX, "_BUNDLES", 1);
+  lua_pushvalue(L, -2);
+  lua_rawseti(L, -2, (int)lua_objlen(L, -2) + 1);
+  lua_pushboolean(L, 1);
+  return 1;
+}
+
+/* ------------------------------------------------------------------------ */
+
 static int lj_cf_package_loader_preload(lua_State *L)
 {
   const char *name = luaL_checkstring(L, 1);
@@ -388,7 +569,9 @@ static int lj_cf_package_loader_preload(lua_State *L)
   if (lua_isnil(L, -1)) {  /* Not found? */
     const char *bcname = mksymname(L, name, SYMPREFIX_BC);
     const char *bcdata = ll_bcsym(NULL, bcname);
-    if (bcdata == NULL || luaL_loadbuffer(L, bcdata, ~(size_t)0, name) != 0)
+    if ((bcdata == NULL ||
+	 luaL_loadbuffer(L, bcdata, ~(size_t)0, name) != 0) &&
+	!ll_loadbundled(L, name))
       lua_pushfstring(L, "\n\tno field package.preload['%s']", name);
   }
   return 1;
@@ -552,6 +735,7 @@ static void setpath(lua_State *L, const char *fieldname, const char *envname,
 
 static const luaL_Reg package_lib[] = {
   { "loadlib",	lj_cf_package_loadlib },
+  { "loadbundle",  lj_cf_package_loadbundle },
   { "searchpath",  lj_cf_package_searchpath },
   { "seeall",	lj_cf_package_seeall },
   { NULL, NULL }
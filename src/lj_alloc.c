@@ -186,10 +186,46 @@ static LJ_AINLINE int CALL_MUNMAP(void *ptr, size_t size)
 #define MMAP_REGION_START	((uintptr_t)0)
 #endif
 
+#if LJ_TARGET_LINUX
+/* Probe the rest of the lower 2GB with address hints once MAP_32BIT fails. */
+#define MMAP_PROBE_START	((uintptr_t)0x10000)
+#define MMAP_PROBE_END		((uintptr_t)0x80000000)
+#define MMAP_PROBE_STEP		((uintptr_t)0x1000000)
+
+static void *mmap_probe(size_t size)
+{
+  /* Hint for next allocation. Doesn't need to be thread-safe. */
+  static uintptr_t alloc_hint = MMAP_PROBE_START;
+  uintptr_t hint = alloc_hint;
+  int wrapped = 0;
+  for (;;) {
+    void *p;
+    if (hint + size >= MMAP_PROBE_END || (wrapped && hint >= alloc_hint)) {
+      if (wrapped) break;
+      wrapped = 1;
+      hint = MMAP_PROBE_START;
+      continue;
+    }
+    p = mmap((void *)hint, size, MMAP_PROT, MMAP_FLAGS, -1, 0);
+    if ((uintptr_t)p >= MMAP_PROBE_START &&
+	(uintptr_t)p + size < MMAP_PROBE_END) {
+      alloc_hint = (uintptr_t)p + size;
+      return p;
+    }
+    if (p != CMFAIL) munmap(p, size);
+    hint += MMAP_PROBE_STEP;
+  }
+  return CMFAIL;
+}
+#endif
+
 static LJ_AINLINE void *CALL_MMAP(size_t size)
 {
   int olderr = errno;
   void *ptr = mmap((void *)MMAP_REGION_START, size, MMAP_PROT, MAP_32BIT|MMAP_FLAGS, -1, 0);
+#if LJ_TARGET_LINUX
+  if (ptr == MFAIL) ptr = mmap_probe(size);
+#endif
   errno = olderr;
   return ptr;
 }
@@ -24,6 +24,7 @@
 #include "lj_trace.h"
 #include "lj_vm.h"
 #include "lj_strscan.h"
+#include "luajit.h"
 
 /* -- Common helper functions --------------------------------------------- */
 
@@ -589,6 +590,13 @@ LUA_API void lua_pushlstring(lua_State *L, const char *str, size_t len)
   incr_top(L);
 }
 
+LUA_API const luaJIT_Key *luaJIT_key(lua_State *L, const char *k)
+{
+  GCstr *s = lj_str_newz(L, k);
+  fixstring(s);  /* Key handles are never collected. */
+  return (const luaJIT_Key *)s;
+}
+
 LUA_API void lua_pushstring(lua_State *L, const char *str)
 {
   if (str == NULL) {
@@ -741,12 +749,12 @@ LUA_API void lua_gettable(lua_State *L, int idx)
   copyTV(L, L->top-1, v);
 }
 
-LUA_API void lua_getfield(lua_State *L, int idx, const char *k)
+static void api_getfield(lua_State *L, int idx, GCstr *k)
 {
   cTValue *v, *t = index2adr(L, idx);
   TValue key;
   api_checkvalidindex(L, t);
-  setstrV(L, &key, lj_str_newz(L, k));
+  setstrV(L, &key, k);
   v = lj_meta_tget(L, t, &key);
   if (v == NULL) {
     L->top += 2;
@@ -758,6 +766,16 @@ LUA_API void lua_getfield(lua_State *L, int idx, const char *k)
   incr_top(L);
 }
 
+LUA_API void lua_getfield(lua_State *L, int idx, const char *k)
+{
+  api_getfield(L, idx, lj_str_newz(L, k));
+}
+
+LUA_API void luaJIT_getfieldk(lua_State *L, int idx, const luaJIT_Key *k)
+{
+  api_getfield(L, idx, (GCstr *)k);
+}
+
 LUA_API void lua_rawget(lua_State *L, int idx)
 {
   cTValue *t = index2adr(L, idx);
@@ -904,14 +922,14 @@ LUA_API void lua_settable(lua_State *L, int idx)
   }
 }
 
-LUA_API void lua_setfield(lua_State *L, int idx, const char *k)
+static void api_setfield(lua_State *L, int idx, GCstr *k)
 {
   TValue *o;
   TValue key;
   cTValue *t = index2adr(L, idx);
   api_checknelems(L, 1);
   api_checkvalidindex(L, t);
-  setstrV(L, &key, lj_str_newz(L, k));
+  setstrV(L, &key, k);
   o = lj_meta_tset(L, t, &key);
   if (o) {
     L->top--;
@@ -925,6 +943,16 @@ LUA_API void lua_setfield(lua_State *L, int idx, const char *k)
   }
 }
 
+LUA_API void lua_setfield(lua_State *L, int idx, const char *k)
+{
+  api_setfield(L, idx, lj_str_newz(L, k));
+}
+
+LUA_API void luaJIT_setfieldk(lua_State *L, int idx, const luaJIT_Key *k)
+{
+  api_setfield(L, idx, (GCstr *)k);
+}
+
 LUA_API void lua_rawset(lua_State *L, int idx)
 {
   GCtab *t = tabV(index2adr(L, idx));
@@ -1027,6 +1055,86 @@ LUA_API const char *lua_setupvalue(lua_State *L, int idx, int n)
   return name;
 }
 
+/* -- Batched operations -------------------------------------------------- */
+
+LUA_API void luaJIT_pushstrings(lua_State *L, const char *const *s,
+				const size_t *len, int n)
+{
+  int i;
+  api_check(L, n >= 0);
+  lj_state_checkstack(L, (MSize)n);
+  lj_gc_check(L);
+  for (i = 0; i < n; i++, L->top++)
+    setstrV(L, L->top, lj_str_new(L, s[i], len ? len[i] : strlen(s[i])));
+}
+
+LUA_API void luaJIT_pushnumarray(lua_State *L, const lua_Number *v, int n)
+{
+  GCtab *t;
+  TValue *array;
+  int i;
+  api_check(L, n >= 0);
+  lj_gc_check(L);
+  t = lj_tab_new(L, (uint32_t)(n > 0 ? n+1 : 0), 0);
+  array = tvref(t->array);
+  for (i = 0; i < n; i++) {
+    TValue *o = &array[i+1];
+    setnumV(o, v[i]);
+    if (LJ_UNLIKELY(tvisnan(o)))
+      setnanV(o);  /* Canonicalize injected NaNs. */
+  }
+  settabV(L, L->top, t);
+  incr_top(L);
+}
+
+LUA_API void luaJIT_pushstrarray(lua_State *L, const char *const *s,
+				 const size_t *len, int n)
+{
+  GCtab *t;
+  TValue *array;
+  int i;
+  api_check(L, n >= 0);
+  lj_gc_check(L);
+  t = lj_tab_new(L, (uint32_t)(n > 0 ? n+1 : 0), 0);
+  settabV(L, L->top, t);
+  incr_top(L);
+  array = tvref(t->array);
+  for (i = 0; i < n; i++)  /* No barrier needed for a new (white) table. */
+    setstrV(L, &array[i+1], lj_str_new(L, s[i], len ? len[i] : strlen(s[i])));
+}
+
+LUA_API void luaJIT_setfields(lua_State *L, int idx, const char *const *k,
+			      int n)
+{
+  GCtab *t = tabV(index2adr(L, idx));
+  TValue *src;
+  int i;
+  api_check(L, n >= 0);
+  api_checknelems(L, n);
+  src = L->top - n;
+  for (i = 0; i < n; i++) {
+    TValue *dst = lj_tab_setstr(L, t, lj_str_newz(L, k[i]));
+    copyTV(L, dst, src+i);
+  }
+  lj_gc_anybarriert(L, t);
+  L->top = src;
+}
+
+LUA_API int luaJIT_tonumarray(lua_State *L, int idx, lua_Number *buf, int n)
+{
+  cTValue *o = index2adr(L, idx);
+  GCtab *t;
+  int i;
+  api_check(L, tvistab(o));
+  t = tabV(o);
+  for (i = 0; i < n; i++) {
+    cTValue *tv = lj_tab_getint(t, i+1);
+    if (!tv || !tvisnumber(tv)) break;
+    buf[i] = numberVnum(tv);
+  }
+  return i;
+}
+
 /* -- Calls --------------------------------------------------------------- */
 
 LUA_API void lua_call(lua_State *L, int nargs, int nresults)
@@ -1180,6 +1288,9 @@ LUA_API int lua_gc(lua_State *L, int what, int data)
     res = (int)(g->gc.stepmul);
     g->gc.stepmul = (MSize)data;
     break;
+  case LUA_GCFREEZE:
+    lj_gc_freeze(L);
+    break;
   default:
     res = -1;  /* Invalid option. */
   }
@@ -181,8 +181,10 @@
   _(JLOOP,	rbase,	___,	lit,	___) \
   \
   _(JMP,	rbase,	___,	jump,	___) \
+  _(SWITCH,	var,	___,	tab,	___) \
   \
   /* Function headers. I/J = interp/JIT, F/V/C = fixarg/vararg/C func. */ \
+  /* Must be last, since the static dispatch table ends at BC_FUNCF. */ \
   _(FUNCF,	rbase,	___,	___,	___) \
   _(IFUNCF,	rbase,	___,	___,	___) \
   _(JFUNCF,	rbase,	___,	lit,	___) \
@@ -222,6 +224,7 @@ LJ_STATIC_ASSERT((int)BC_FUNCF + 1 == (int)BC_IFUNCF);
 LJ_STATIC_ASSERT((int)BC_FUNCF + 2 == (int)BC_JFUNCF);
 LJ_STATIC_ASSERT((int)BC_FUNCV + 1 == (int)BC_IFUNCV);
 LJ_STATIC_ASSERT((int)BC_FUNCV + 2 == (int)BC_JFUNCV);
+LJ_STATIC_ASSERT((int)BC_FUNCCW + 1 == (int)BC__MAX);
 
 /* This solves a circular dependency problem, change as needed. */
 #define FF_next_N	4
@@ -36,7 +36,10 @@
 /* If you perform *any* kind of private modifications to the bytecode itself
 ** or to the dump format, you *must* set BCDUMP_VERSION to 0x80 or higher.
 */
-#define BCDUMP_VERSION		1
+#define BCDUMP_VERSION		0x80
+
+/* Dumps without BC_SWITCH are written and read with the standard version. */
+#define BCDUMP_VERSION_OLD	1
 
 /* Compatibility flags. */
 #define BCDUMP_F_BE		0x01
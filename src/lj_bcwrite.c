@@ -329,6 +329,25 @@ static void bcwrite_proto(BCWriteCtx *ctx, GCproto *pt)
   }
 }
 
+/* Check whether a prototype or any of its children uses BC_SWITCH. */
+static int bcwrite_hasswitch(GCproto *pt)
+{
+  MSize i;
+  for (i = 1; i < pt->sizebc; i++)
+    if (bc_op(proto_bc(pt)[i]) == BC_SWITCH)
+      return 1;
+  if ((pt->flags & PROTO_CHILD)) {
+    ptrdiff_t j, n = pt->sizekgc;
+    GCRef *kr = mref(pt->k, GCRef) - 1;
+    for (j = 0; j < n; j++, kr--) {
+      GCobj *o = gcref(*kr);
+      if (o->gch.gct == ~LJ_TPROTO && bcwrite_hasswitch(gco2pt(o)))
+	return 1;
+    }
+  }
+  return 0;
+}
+
 /* Write header of bytecode dump. */
 static void bcwrite_header(BCWriteCtx *ctx)
 {
@@ -340,7 +359,9 @@ static void bcwrite_header(BCWriteCtx *ctx)
   bcwrite_byte(ctx, BCDUMP_HEAD1);
   bcwrite_byte(ctx, BCDUMP_HEAD2);
   bcwrite_byte(ctx, BCDUMP_HEAD3);
-  bcwrite_byte(ctx, BCDUMP_VERSION);
+  /* Dumps without BC_SWITCH can still be loaded by standard LuaJIT. */
+  bcwrite_byte(ctx, bcwrite_hasswitch(ctx->pt) ? BCDUMP_VERSION :
+						 BCDUMP_VERSION_OLD);
   bcwrite_byte(ctx, (ctx->strip ? BCDUMP_F_STRIP : 0) +
 		   (LJ_BE ? BCDUMP_F_BE : 0) +
 		   ((ctx->pt->flags & PROTO_FFI) ? BCDUMP_F_FFI : 0));
@@ -751,4 +751,92 @@ void lj_cconv_ct_init(CTState *cts, CType *d, CTSize sz,
     cconv_err_initov(cts, d);
 }
 
+/* -- Bulk conversions between tables and C arrays ------------------------ */
+
+/* Type-specialized loop over the array part of a table. */
+#define CCONV_FROMTAB(ctt, conv) \
+  for (; i < na; i++) { \
+    if (LJ_LIKELY(tvisnum(&o[i]))) ((ctt *)dp)[i] = (ctt)conv(numV(&o[i])); \
+    else if (tvisint(&o[i])) ((ctt *)dp)[i] = (ctt)intV(&o[i]); \
+    else return i; \
+  }
+
+#define CCONV_NOP(x)	(x)
+
+/* Convert table elements 1..n to a C array with elements of type did.
+** Returns the number of converted elements. This is less than n, if an
+** element is not a number. Never throws, since it's called from traces.
+*/
+MSize lj_cconv_fromtab(lua_State *L, uint8_t *dp, GCtab *t, MSize n,
+		       CTypeID did)
+{
+  CTState *cts = ctype_ctsG(G(L));
+  CType *d = ctype_raw(cts, did);
+  CTInfo dinfo = d->info;
+  CTSize dsize = d->size;
+  cTValue *o = tvref(t->array)+1;
+  MSize i = 0, na = t->asize > n ? n : t->asize ? t->asize-1 : 0;
+  lua_assert(ctype_isnum(dinfo));
+  if (ctype_isfp(dinfo)) {
+    if (dsize == sizeof(double)) {
+      CCONV_FROMTAB(double, CCONV_NOP)
+    } else if (dsize == sizeof(float)) {
+      CCONV_FROMTAB(float, CCONV_NOP)
+    }
+  } else if (ctype_isinteger(dinfo) && !(dinfo & CTF_UNSIGNED)) {
+    /* Same conversions as CCX(I, F) in lj_cconv_ct_ct(). */
+    if (dsize == 4) {
+      CCONV_FROMTAB(int32_t, (int32_t))
+    } else if (dsize == 8) {
+      CCONV_FROMTAB(int64_t, (int64_t))
+    }
+  }
+  /* Generic conversion of the remaining elements. */
+  for (; i < n; i++) {
+    cTValue *tv = lj_tab_getint(t, (int32_t)(i+1));
+    if (!tv || !tvisnumber(tv))
+      break;
+    lj_cconv_ct_tv(cts, d, dp + i*dsize, (TValue *)tv, 0);
+  }
+  return i;
+}
+
+#undef CCONV_FROMTAB
+#undef CCONV_NOP
+
+/* Convert n elements of a C array of numbers to table elements 1..n.
+** 64 bit integers are converted to Lua numbers and may lose precision.
+*/
+void lj_cconv_totab(CTState *cts, CType *s, uint8_t *sp, GCtab *t, MSize n)
+{
+  CTInfo sinfo = s->info;
+  CTSize ssize = s->size;
+  TValue *o;
+  MSize i;
+  lua_assert(ctype_isnum(sinfo));
+  if (t->asize < n+1)
+    lj_tab_reasize(cts->L, t, n+1);
+  o = tvref(t->array)+1;
+  if (ctype_isfp(sinfo)) {
+    if (ssize == sizeof(double))
+      for (i = 0; i < n; i++) setnumV(&o[i], ((double *)sp)[i]);
+    else
+      for (i = 0; i < n; i++) setnumV(&o[i], (lua_Number)((float *)sp)[i]);
+  } else if (ctype_isinteger(sinfo) && ssize == 4) {
+    if (!(sinfo & CTF_UNSIGNED))
+      for (i = 0; i < n; i++) setintV(&o[i], ((int32_t *)sp)[i]);
+    else
+      for (i = 0; i < n; i++) setnumV(&o[i], (lua_Number)((uint32_t *)sp)[i]);
+  } else if (ctype_isinteger(sinfo) && ssize == 8) {
+    if (!(sinfo & CTF_UNSIGNED))
+      for (i = 0; i < n; i++) setnumV(&o[i], (lua_Number)((int64_t *)sp)[i]);
+    else
+      for (i = 0; i < n; i++) setnumV(&o[i], (lua_Number)((uint64_t *)sp)[i]);
+  } else {
+    CTypeID sid = ctype_typeid(cts, s);
+    for (i = 0; i < n; i++)
+      lj_cconv_tv_ct(cts, s, sid, &o[i], sp + i*ssize);
+  }
+}
+
 #endif
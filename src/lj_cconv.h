@@ -62,6 +62,10 @@ LJ_FUNC void lj_cconv_ct_tv(CTState *cts, CType *d,
 			    uint8_t *dp, TValue *o, CTInfo flags);
 LJ_FUNC void lj_cconv_bf_tv(CTState *cts, CType *d, uint8_t *dp, TValue *o);
 LJ_FUNC int lj_cconv_multi_init(CTState *cts, CType *d, TValue *o);
+LJ_FUNCA MSize lj_cconv_fromtab(lua_State *L, uint8_t *dp, GCtab *t, MSize n,
+			       CTypeID did);
+LJ_FUNC void lj_cconv_totab(CTState *cts, CType *s, uint8_t *sp, GCtab *t,
+			    MSize n);
 LJ_FUNC void lj_cconv_ct_init(CTState *cts, CType *d, CTSize sz,
 			      uint8_t *dp, TValue *o, MSize len);
 
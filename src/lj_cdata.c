@@ -94,6 +94,16 @@ TValue * LJ_FASTCALL lj_cdata_setfin(lua_State *L, GCcdata *cd)
   }
 }
 
+/* Flag cdata to be finalized by the __gc metamethod of its ctype.
+** This doesn't add it to the finalizer table. The metamethod is only
+** resolved when the cdata is finalized. See gc_finalize().
+*/
+void LJ_FASTCALL lj_cdata_setmetafin(lua_State *L, GCcdata *cd)
+{
+  if (gcref(ctype_ctsG(G(L))->finalizer->metatable))  /* Still enabled? */
+    cd->marked |= LJ_GC_CDATA_FIN;
+}
+
 /* -- C data indexing ----------------------------------------------------- */
 
 /* Index C data by a TValue. Return CType and pointer. */
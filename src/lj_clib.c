@@ -112,15 +112,15 @@ static const char *clib_resolve_lds(lua_State *L, const char *name)
   return p;
 }
 
-static void *clib_loadlib(lua_State *L, const char *name, int global)
+static void *clib_loadlib(lua_State *L, const char *name, int global, int now)
 {
-  void *h = dlopen(clib_extname(L, name),
-		   RTLD_LAZY | (global?RTLD_GLOBAL:RTLD_LOCAL));
+  int mode = (now?RTLD_NOW:RTLD_LAZY) | (global?RTLD_GLOBAL:RTLD_LOCAL);
+  void *h = dlopen(clib_extname(L, name), mode);
   if (!h) {
     const char *e, *err = dlerror();
     if (err && *err == '/' && (e = strchr(err, ':')) &&
 	(name = clib_resolve_lds(L, strdata(lj_str_new(L, err, e-err))))) {
-      h = dlopen(name, RTLD_LAZY | (global?RTLD_GLOBAL:RTLD_LOCAL));
+      h = dlopen(name, mode);
       if (h) return h;
       err = dlerror();
     }
@@ -197,13 +197,13 @@ static const char *clib_extname(lua_State *L, const char *name)
   return name;
 }
 
-static void *clib_loadlib(lua_State *L, const char *name, int global)
+static void *clib_loadlib(lua_State *L, const char *name, int global, int now)
 {
   DWORD oldwerr = GetLastError();
   void *h = (void *)LoadLibraryA(clib_extname(L, name));
   if (!h) clib_error(L, "cannot load module " LUA_QS ": %s", name);
   SetLastError(oldwerr);
-  UNUSED(global);
+  UNUSED(global); UNUSED(now);
   return h;
 }
 
@@ -267,10 +267,10 @@ LJ_NORET LJ_NOINLINE static void clib_error(lua_State *L, const char *fmt,
   lj_err_callermsg(L, lj_str_pushf(L, fmt, name, "no support for this OS"));
 }
 
-static void *clib_loadlib(lua_State *L, const char *name, int global)
+static void *clib_loadlib(lua_State *L, const char *name, int global, int now)
 {
   lj_err_callermsg(L, "no support for loading dynamic libraries for this OS");
-  UNUSED(name); UNUSED(global);
+  UNUSED(name); UNUSED(global); UNUSED(now);
   return NULL;
 }
 
@@ -317,6 +317,47 @@ static const char *clib_extsym(CTState *cts, CType *ct, GCstr *name)
   return strdata(name);
 }
 
+/* Resolve the address of a declared function or extern symbol. */
+static void *clib_symaddr(lua_State *L, CTState *cts, CLibrary *cl,
+			  CType *ct, const char *sym)
+{
+#if LJ_TARGET_WINDOWS
+  DWORD oldwerr = GetLastError();
+#endif
+  void *p = clib_getsym(cl, sym);
+  lua_assert(ctype_isfunc(ct->info) || ctype_isextern(ct->info));
+#if LJ_TARGET_X86 && LJ_ABI_WIN
+  /* Retry with decorated name for fastcall/stdcall functions. */
+  if (!p && ctype_isfunc(ct->info)) {
+    CTInfo cconv = ctype_cconv(ct->info);
+    if (cconv == CTCC_FASTCALL || cconv == CTCC_STDCALL) {
+      CTSize sz = clib_func_argsize(cts, ct);
+      const char *symd = lj_str_pushf(L,
+			   cconv == CTCC_FASTCALL ? "@%s@%d" : "_%s@%d",
+			   sym, sz);
+      L->top--;
+      p = clib_getsym(cl, symd);
+    }
+  }
+#else
+  UNUSED(L); UNUSED(cts); UNUSED(ct);
+#endif
+#if LJ_TARGET_WINDOWS
+  SetLastError(oldwerr);
+#endif
+  return p;
+}
+
+/* Store a resolved symbol address in the cache. */
+static void clib_setsym(lua_State *L, CTState *cts, CLibrary *cl,
+			TValue *tv, CTypeID id, void *p)
+{
+  GCcdata *cd = lj_cdata_new(cts, id, CTSIZE_PTR);
+  *(void **)cdataptr(cd) = p;
+  setcdataV(L, tv, cd);
+  lj_gc_anybarriert(L, cl->cache);
+}
+
 /* Index a C library by name. */
 TValue *lj_clib_index(lua_State *L, CLibrary *cl, GCstr *name)
 {
@@ -336,40 +377,40 @@ TValue *lj_clib_index(lua_State *L, CLibrary *cl, GCstr *name)
 	setintV(tv, (int32_t)ct->size);
     } else {
       const char *sym = clib_extsym(cts, ct, name);
-#if LJ_TARGET_WINDOWS
-      DWORD oldwerr = GetLastError();
-#endif
-      void *p = clib_getsym(cl, sym);
-      GCcdata *cd;
-      lua_assert(ctype_isfunc(ct->info) || ctype_isextern(ct->info));
-#if LJ_TARGET_X86 && LJ_ABI_WIN
-      /* Retry with decorated name for fastcall/stdcall functions. */
-      if (!p && ctype_isfunc(ct->info)) {
-	CTInfo cconv = ctype_cconv(ct->info);
-	if (cconv == CTCC_FASTCALL || cconv == CTCC_STDCALL) {
-	  CTSize sz = clib_func_argsize(cts, ct);
-	  const char *symd = lj_str_pushf(L,
-			       cconv == CTCC_FASTCALL ? "@%s@%d" : "_%s@%d",
-			       sym, sz);
-	  L->top--;
-	  p = clib_getsym(cl, symd);
-	}
-      }
-#endif
+      void *p = clib_symaddr(L, cts, cl, ct, sym);
       if (!p)
 	clib_error(L, "cannot resolve symbol " LUA_QS ": %s", sym);
-#if LJ_TARGET_WINDOWS
-      SetLastError(oldwerr);
-#endif
-      cd = lj_cdata_new(cts, id, CTSIZE_PTR);
-      *(void **)cdataptr(cd) = p;
-      setcdataV(L, tv, cd);
-      lj_gc_anybarriert(L, cl->cache);
+      clib_setsym(L, cts, cl, tv, id, p);
     }
   }
   return tv;
 }
 
+/* Resolve all functions and extern symbols declared so far in one go.
+** Symbols not found in the library are skipped. They may be defined by
+** other libraries and indexing them still throws an error as usual.
+*/
+static void clib_bind(lua_State *L, CLibrary *cl)
+{
+  CTState *cts = ctype_cts(L);
+  CTypeID id;
+  for (id = 1; id < cts->top; id++) {
+    CType *ct = ctype_get(cts, id);
+    GCstr *name = gcrefp(ct->name, GCstr);
+    if ((ctype_isfunc(ct->info) || ctype_isextern(ct->info)) && name) {
+      CType *ctn;
+      cTValue *o = lj_tab_getstr(cl->cache, name);
+      /* Only for declarations that are visible in the C library namespace. */
+      if ((!o || tvisnil(o)) &&
+	  lj_ctype_getname(cts, &ctn, name, CLNS_INDEX) == id) {
+	void *p = clib_symaddr(L, cts, cl, ct, clib_extsym(cts, ct, name));
+	if (p)
+	  clib_setsym(L, cts, cl, lj_tab_setstr(L, cl->cache, name), id, p);
+      }
+    }
+  }
+}
+
 /* -- C library management ------------------------------------------------ */
 
 /* Create a new CLibrary object and push it on the stack. */
@@ -386,12 +427,14 @@ static CLibrary *clib_new(lua_State *L, GCtab *mt)
   return cl;
 }
 
-/* Load a C library. */
-void lj_clib_load(lua_State *L, GCtab *mt, GCstr *name, int global)
+/* Load a C library. Optionally resolve all declared symbols right away. */
+void lj_clib_load(lua_State *L, GCtab *mt, GCstr *name, int global, int now)
 {
-  void *handle = clib_loadlib(L, strdata(name), global);
+  void *handle = clib_loadlib(L, strdata(name), global, now);
   CLibrary *cl = clib_new(L, mt);
   cl->handle = handle;
+  if (now)
+    clib_bind(L, cl);
 }
 
 /* Unload a C library. */
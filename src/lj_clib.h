@@ -20,7 +20,8 @@ typedef struct CLibrary {
 } CLibrary;
 
 LJ_FUNC TValue *lj_clib_index(lua_State *L, CLibrary *cl, GCstr *name);
-LJ_FUNC void lj_clib_load(lua_State *L, GCtab *mt, GCstr *name, int global);
+LJ_FUNC void lj_clib_load(lua_State *L, GCtab *mt, GCstr *name, int global,
+			  int now);
 LJ_FUNC void lj_clib_unload(CLibrary *cl);
 LJ_FUNC void lj_clib_default(lua_State *L, GCtab *mt);
 
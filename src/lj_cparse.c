@@ -1174,7 +1174,7 @@ static void cp_decl_attributes(CPState *cp, CPDecl *decl)
     switch (cp->tok) {
     case CTOK_CONST: decl->attr |= CTF_CONST; break;
     case CTOK_VOLATILE: decl->attr |= CTF_VOLATILE; break;
-    case CTOK_RESTRICT: break;  /* Ignore. */
+    case CTOK_RESTRICT: decl->attr |= CTF_RESTRICT; break;
     case CTOK_EXTENSION: break;  /* Ignore. */
     case CTOK_ATTRIBUTE: cp_decl_gccattribute(cp, decl); continue;
     case CTOK_ASM: cp_decl_asm(cp, decl); continue;
@@ -1676,11 +1676,13 @@ static void cp_declarator(CPState *cp, CPDecl *decl)
 	info = CTINFO(CT_PTR, CTALIGN(2));
       }
 #endif
-      info += (decl->attr & (CTF_QUAL|CTF_REF));
-      decl->attr &= ~(CTF_QUAL|(CTMASK_MSIZEP<<CTSHIFT_MSIZEP));
+      info += (decl->attr & (CTF_QUAL|CTF_REF|CTF_RESTRICT));
+      decl->attr &= ~(CTF_QUAL|CTF_RESTRICT|
+		      (CTMASK_MSIZEP<<CTSHIFT_MSIZEP));
       cp_push(decl, info, sz);
     } else if (cp_opt(cp, '&') || cp_opt(cp, CTOK_ANDAND)) {  /* Reference. */
-      decl->attr &= ~(CTF_QUAL|(CTMASK_MSIZEP<<CTSHIFT_MSIZEP));
+      decl->attr &= ~(CTF_QUAL|CTF_RESTRICT|
+		      (CTMASK_MSIZEP<<CTSHIFT_MSIZEP));
       cp_push(decl, CTINFO_REF(0), CTSIZE_PTR);
     } else {
       break;
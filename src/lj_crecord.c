@@ -56,6 +56,44 @@ static GCcdata *argv2cdata(jit_State *J, TRef tr, cTValue *o)
   return cd;
 }
 
+/* Load the pointer held by a cdata object.
+**
+** Restrict-qualified pointers are tagged for alias analysis. It assumes
+** that different cdata.rptr loads belong to different cdata objects, so
+** every new load is guarded against the previous ones. An object already
+** loaded through another reference is guarded to be the same and reuses
+** that load. Beyond RPTR_MAX objects the restrict qualifier is ignored.
+*/
+static TRef crec_cdata_ptr(jit_State *J, TRef tr, GCcdata *cd, CType *ct,
+			   IRType t)
+{
+  if ((ct->info & CTF_RESTRICT)) {
+    MSize i, n = J->nrptr;
+    TRef trp;
+    for (i = 0; i < n; i++) {
+      IRIns *ir = IR(J->rptr[i]);
+      if (ir->op1 == tref_ref(tr))
+	return TREF(J->rptr[i], t);
+      if (gcref(J->rptrcd[i]) == obj2gco(cd)) {
+	emitir(IRTG(IR_EQ, IRT_CDATA), tr, ir->op1);
+	return TREF(J->rptr[i], t);
+      }
+    }
+    if (n < RPTR_MAX) {
+      trp = emitir(IRT(IR_FLOAD, t), tr, IRFL_CDATA_RPTR);
+      if (IR(tref_ref(trp))->o == IR_FLOAD) {
+	for (i = 0; i < n; i++)
+	  emitir(IRTG(IR_NE, IRT_CDATA), tr, IR(J->rptr[i])->op1);
+	J->rptr[n] = (IRRef1)tref_ref(trp);
+	setgcref(J->rptrcd[n], obj2gco(cd));
+	J->nrptr = n+1;
+      }
+      return trp;
+    }
+  }
+  return emitir(IRT(IR_FLOAD, t), tr, IRFL_CDATA_PTR);
+}
+
 /* Specialize to the CTypeID held by a cdata constructor. */
 static CTypeID crec_constructor(jit_State *J, GCcdata *cd, TRef tr)
 {
@@ -647,7 +685,7 @@ static TRef crec_ct_tv(jit_State *J, CType *d, TRef dp, TRef sp, cTValue *sval)
     svisnz = cdataptr(cdataV(sval));
     t = crec_ct2irt(cts, s);
     if (ctype_isptr(s->info)) {
-      sp = emitir(IRT(IR_FLOAD, t), sp, IRFL_CDATA_PTR);
+      sp = crec_cdata_ptr(J, sp, cdataV(sval), s, t);
       if (ctype_isref(s->info)) {
 	svisnz = *(void **)svisnz;
 	s = ctype_rawchild(cts, s);
@@ -739,8 +777,8 @@ void LJ_FASTCALL recff_cdata_index(jit_State *J, RecordFFData *rd)
   /* Resolve pointer or reference for cdata object. */
   if (ctype_isptr(ct->info)) {
     IRType t = (LJ_64 && ct->size == 8) ? IRT_P64 : IRT_P32;
+    ptr = crec_cdata_ptr(J, ptr, cd, ct, t);
     if (ctype_isref(ct->info)) ct = ctype_rawchild(cts, ct);
-    ptr = emitir(IRT(IR_FLOAD, t), ptr, IRFL_CDATA_PTR);
     ofs = 0;
     ptr = crec_reassoc_ofs(J, ptr, &ofs, 1);
   }
@@ -905,7 +943,6 @@ static void crec_alloc(jit_State *J, RecordFFData *rd, CTypeID id)
     J->base[0] = emitir(IRTG(IR_CNEWI, IRT_CDATA), trid, sp);
   } else {
     TRef trcd = emitir(IRTG(IR_CNEW, IRT_CDATA), trid, TREF_NIL);
-    cTValue *fin;
     J->base[0] = trcd;
     if (J->base[1] && !J->base[2] &&
 	!lj_cconv_multi_init(cts, d, &rd->argv[1])) {
@@ -982,9 +1019,8 @@ static void crec_alloc(jit_State *J, RecordFFData *rd, CTypeID id)
       }
     }
     /* Handle __gc metamethod. */
-    fin = lj_ctype_meta(cts, id, MM_gc);
-    if (fin)
-      crec_finalizer(J, trcd, fin);
+    if (lj_ctype_meta(cts, id, MM_gc))
+      lj_ir_call(J, IRCALL_lj_cdata_setmetafin, trcd);
   }
 }
 
@@ -1382,7 +1418,7 @@ void LJ_FASTCALL recff_cdata_arith(jit_State *J, RecordFFData *rd)
       ct = ctype_raw(cts, id);
       t = crec_ct2irt(cts, ct);
       if (ctype_isptr(ct->info)) {  /* Resolve pointer or reference. */
-	tr = emitir(IRT(IR_FLOAD, t), tr, IRFL_CDATA_PTR);
+	tr = crec_cdata_ptr(J, tr, cdataV(&rd->argv[i]), ct, t);
 	if (ctype_isref(ct->info)) {
 	  ct = ctype_rawchild(cts, ct);
 	  t = crec_ct2irt(cts, ct);
@@ -1569,6 +1605,42 @@ void LJ_FASTCALL recff_ffi_copy(jit_State *J, RecordFFData *rd)
   }  /* else: interpreter will throw. */
 }
 
+void LJ_FASTCALL recff_ffi_find(jit_State *J, RecordFFData *rd)
+{
+  CTState *cts = ctype_ctsG(J2G(J));
+  TRef trp = J->base[0], trlen = J->base[1], trstr = J->base[2];
+  if (trp && trlen && tref_isstr(trstr)) {
+    GCstr *str = strV(&rd->argv[2]);
+    const char *p;
+    int32_t len;
+    TRef trptr, trslen, tr;
+    trp = crec_ct_tv(J, ctype_get(cts, CTID_P_CVOID), 0, trp, &rd->argv[0]);
+    trlen = crec_toint(J, cts, trlen, &rd->argv[1]);
+    emitir(IRTGI(IR_GE), trlen, lj_ir_kint(J, 0));
+    trptr = emitir(IRT(IR_STRREF, IRT_P32), trstr, lj_ir_kint(J, 0));
+    trslen = emitir(IRTI(IR_FLOAD), trstr, IRFL_STR_LEN);
+    tr = lj_ir_call(J, IRCALL_lj_str_find, trp, trptr, trlen, trslen);
+    /* Search now to specialize the trace to the found/not found case. */
+    lj_cconv_ct_tv(cts, ctype_get(cts, CTID_P_CVOID), (uint8_t *)&p,
+		   &rd->argv[0], 0);
+    lj_cconv_ct_tv(cts, ctype_get(cts, CTID_INT32), (uint8_t *)&len,
+		   &rd->argv[1], 0);
+    if (len < 0)
+      return;  /* Interpreter will throw. */
+    if (!lj_str_find(p, strdata(str), (MSize)len, str->len)) {
+      emitir(IRTG(IR_EQ, IRT_PTR), tr, lj_ir_kptr(J, NULL));
+      J->base[0] = TREF_NIL;
+    } else {
+      emitir(IRTG(IR_NE, IRT_PTR), tr, lj_ir_kptr(J, NULL));
+      tr = emitir(IRT(IR_SUB, IRT_INTP), tr, trp);
+#if LJ_64
+      tr = emitconv(tr, IRT_INT, IRT_INTP, 0);
+#endif
+      J->base[0] = tr;
+    }
+  }  /* else: interpreter will throw. */
+}
+
 void LJ_FASTCALL recff_ffi_fill(jit_State *J, RecordFFData *rd)
 {
   CTState *cts = ctype_ctsG(J2G(J));
@@ -1593,6 +1665,35 @@ void LJ_FASTCALL recff_ffi_fill(jit_State *J, RecordFFData *rd)
   }  /* else: interpreter will throw. */
 }
 
+void LJ_FASTCALL recff_ffi_fromtable(jit_State *J, RecordFFData *rd)
+{
+  CTState *cts = ctype_ctsG(J2G(J));
+  TRef trdst = J->base[0], trtab = J->base[1], trlen = J->base[2];
+  if (trdst && tref_istab(trtab)) {
+    CType *ct = ctype_raw(cts, argv2cdata(J, trdst, &rd->argv[0])->ctypeid);
+    TRef tr;
+    if (ctype_isref(ct->info))
+      ct = ctype_rawchild(cts, ct);
+    if (!(ctype_isptr(ct->info) || ctype_isarray(ct->info)) ||
+	!ctype_isnum(ctype_rawchild(cts, ct)->info))
+      return;  /* Interpreter will throw. */
+    ct = ctype_rawchild(cts, ct);
+    trdst = crec_ct_tv(J, ctype_get(cts, CTID_P_VOID), 0, trdst, &rd->argv[0]);
+    if (trlen && !tref_isnil(trlen)) {
+      trlen = crec_toint(J, cts, trlen, &rd->argv[2]);
+      emitir(IRTGI(IR_GE), trlen, lj_ir_kint(J, 0));
+    } else {
+      trlen = lj_ir_call(J, IRCALL_lj_tab_len, trtab);
+    }
+    tr = lj_ir_call(J, IRCALL_lj_cconv_fromtab, trdst, trtab, trlen,
+		    lj_ir_kint(J, (int32_t)ctype_typeid(cts, ct)));
+    /* Exit to the interpreter, which throws for a non-number element. */
+    emitir(IRTGI(IR_EQ), tr, trlen);
+    emitir(IRT(IR_XBAR, IRT_NIL), 0, 0);
+    rd->nres = 0;
+  }  /* else: interpreter will throw. */
+}
+
 void LJ_FASTCALL recff_ffi_typeof(jit_State *J, RecordFFData *rd)
 {
   if (tref_iscdata(J->base[0])) {
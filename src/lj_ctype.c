@@ -216,6 +216,15 @@ void lj_ctype_addname(CTState *cts, CType *ct, CTypeID id)
   cts->hash[h] = (CTypeID1)id;
 }
 
+/* Add element to hash table, by name if it has one. */
+void lj_ctype_addhash(CTState *cts, CType *ct, CTypeID id)
+{
+  if (gcref(ct->name))
+    lj_ctype_addname(cts, ct, id);
+  else
+    ctype_addtype(cts, ct, id);
+}
+
 /* Get a C type by name, matching the type mask. */
 CTypeID lj_ctype_getname(CTState *cts, CType **ctp, GCstr *name, uint32_t tmask)
 {
@@ -487,6 +496,7 @@ static void ctype_repr(CTRepr *ctr, CTypeID id)
       if ((info & CTF_REF)) {
 	ctype_prepc(ctr, '&');
       } else {
+	if ((info & CTF_RESTRICT)) ctype_preplit(ctr, "restrict");
 	ctype_prepqual(ctr, (qual|info));
 	if (LJ_64 && size == 4) ctype_preplit(ctr, "__ptr32");
 	ctype_prepc(ctr, '*');
@@ -619,6 +629,12 @@ CTState *lj_ctype_init(lua_State *L)
   return cts;
 }
 
+/* Get the number of predefined C types. */
+CTypeID lj_ctype_numpredef(void)
+{
+  return (CTypeID)CTTYPEINFO_NUM;
+}
+
 /* Free C type table and state. */
 void lj_ctype_freestate(global_State *g)
 {
@@ -196,6 +196,7 @@ static void setptmode(global_State *g, GCproto *pt, int mode)
 {
   if ((mode & LUAJIT_MODE_ON)) {  /* (Re-)enable JIT compilation. */
     pt->flags &= ~PROTO_NOJIT;
+    lj_trace_forgetproto(g, pt);  /* Start over with blacklisting, too. */
     lj_trace_reenableproto(pt);  /* Unpatch all ILOOP etc. bytecodes. */
   } else {  /* Flush and/or disable JIT compilation. */
     if (!(mode & LUAJIT_MODE_FLUSH))
@@ -153,6 +153,13 @@ ERRDEF(XGSCOPE,	"<goto %s> jumps into the scope of local " LUA_QS)
 ERRDEF(BCFMT,	"cannot load incompatible bytecode")
 ERRDEF(BCBAD,	"cannot load malformed bytecode")
 
+/* Heap image errors. */
+ERRDEF(IMGFMT,	"cannot load incompatible heap image")
+ERRDEF(IMGBAD,	"cannot load malformed heap image")
+ERRDEF(IMGSAVE,	"cannot save %s in heap image")
+ERRDEF(IMGEXT,	"heap image needs missing " LUA_QS)
+ERRDEF(IMGCTYPE,	"cannot load heap image after C type declarations")
+
 #if LJ_HASFFI
 /* FFI errors. */
 ERRDEF(FFI_INVTYPE,	"invalid C type")
@@ -170,6 +177,7 @@ ERRDEF(FFI_BADARITH,	"attempt to perform arithmetic on " LUA_QS " and " LUA_QS)
 ERRDEF(FFI_BADCOMP,	"attempt to compare " LUA_QS " with " LUA_QS)
 ERRDEF(FFI_BADCALL,	LUA_QS " is not callable")
 ERRDEF(FFI_NUMARG,	"wrong number of arguments for function call")
+ERRDEF(FFI_TABVAL,	"invalid value (%s) at index %d in table")
 ERRDEF(FFI_BADMEMBER,	LUA_QS " has no member named " LUA_QS)
 ERRDEF(FFI_BADIDX,	LUA_QS " cannot be indexed")
 ERRDEF(FFI_BADIDXW,	LUA_QS " cannot be indexed with " LUA_QS)
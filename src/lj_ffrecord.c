@@ -27,6 +27,7 @@
 #include "lj_dispatch.h"
 #include "lj_vm.h"
 #include "lj_strscan.h"
+#include "lj_lib.h"
 
 /* Some local macros to save typing. Undef'd at the end. */
 #define IR(ref)			(&J->cur.ir[(ref)])
@@ -562,18 +563,68 @@ static void LJ_FASTCALL recff_math_minmax(jit_State *J, RecordFFData *rd)
   J->base[0] = tr;
 }
 
+#if LJ_64 && LJ_HASFFI
+/* Record one LFSR generator update. Same as TW223_GEN in lib_math.c. */
+static TRef recff_random_gen(jit_State *J, uint64_t *gen, int k, int q, int s)
+{
+  TRef ptr = lj_ir_kptr(J, gen);
+  TRef z = emitir(IRT(IR_XLOAD, IRT_U64), ptr, 0);
+  TRef tr = emitir(IRT(IR_BSHL, IRT_U64), z, lj_ir_kint(J, q));
+  tr = emitir(IRT(IR_BXOR, IRT_U64), tr, z);
+  tr = emitir(IRT(IR_BSHR, IRT_U64), tr, lj_ir_kint(J, k-s));
+  z = emitir(IRT(IR_BAND, IRT_U64), z,
+	     lj_ir_kint64(J, (uint64_t)(int64_t)-1 << (64-k)));
+  z = emitir(IRT(IR_BSHL, IRT_U64), z, lj_ir_kint(J, s));
+  z = emitir(IRT(IR_BXOR, IRT_U64), tr, z);
+  emitir(IRT(IR_XSTORE, IRT_U64), ptr, z);
+  return z;
+}
+
+/* Update generator i and compute a running xor of all states. */
+#define RANDOM_GEN_REC(i, k, q, s) \
+  z = recff_random_gen(J, &rs->gen[i], k, q, s); \
+  r = r ? emitir(IRT(IR_BXOR, IRT_U64), r, z) : z;
+
+/* Record the PRNG step. Returns a double in the range 0.0 <= d < 1.0. */
+static TRef recff_random_step(jit_State *J, RandomState *rs)
+{
+  TRef z, r = 0;
+  RANDOM_GENDEF(RANDOM_GEN_REC)
+  /* Need a snapshot after the stores, like after a call with side effects.
+  ** Otherwise an exit restarts the call and steps the PRNG twice.
+  */
+  J->needsnap = 1;
+  /* d = (double)(r & (2^52-1)) * 2^-52 is exactly the same as u.d - 1.0. */
+  r = emitir(IRT(IR_BAND, IRT_U64), r,
+	     lj_ir_kint64(J, U64x(000fffff,ffffffff)));
+  r = emitir(IRTN(IR_CONV), r, (IRT_NUM<<IRCONV_DSH)|IRT_I64);
+  return emitir(IRTN(IR_MUL), r, lj_ir_knum(J, 2.220446049250313080847e-16));
+}
+#undef RANDOM_GEN_REC
+#endif
+
 static void LJ_FASTCALL recff_math_random(jit_State *J, RecordFFData *rd)
 {
   GCudata *ud = udataV(&J->fn->c.upvalue[0]);
-  TRef tr, one;
+  TRef tr, one, tr1 = 0, tr2 = 0;
   lj_ir_kgc(J, obj2gco(ud), IRT_UDATA);  /* Prevent collection. */
+  /* Convert the arguments first. No guards may follow the state update. */
+  if (J->base[0]) {
+    tr1 = lj_ir_tonum(J, J->base[0]);
+    if (J->base[1])
+      tr2 = lj_ir_tonum(J, J->base[1]);
+  }
+#if LJ_64 && LJ_HASFFI
+  /* Inline the PRNG step. Avoids the call and the FPR spills around it. */
+  tr = recff_random_step(J, (RandomState *)uddata(ud));
+  one = lj_ir_knum_one(J);
+#else
   tr = lj_ir_call(J, IRCALL_lj_math_random_step, lj_ir_kptr(J, uddata(ud)));
   one = lj_ir_knum_one(J);
   tr = emitir(IRTN(IR_SUB), tr, one);
-  if (J->base[0]) {
-    TRef tr1 = lj_ir_tonum(J, J->base[0]);
-    if (J->base[1]) {  /* d = floor(d*(r2-r1+1.0)) + r1 */
-      TRef tr2 = lj_ir_tonum(J, J->base[1]);
+#endif
+  if (tr1) {
+    if (tr2) {  /* d = floor(d*(r2-r1+1.0)) + r1 */
       tr2 = emitir(IRTN(IR_SUB), tr2, tr1);
       tr2 = emitir(IRTN(IR_ADD), tr2, one);
       tr = emitir(IRTN(IR_MUL), tr, tr2);
@@ -19,6 +19,10 @@
 
 void LJ_FASTCALL lj_func_freeproto(global_State *g, GCproto *pt)
 {
+#if LJ_HASJIT
+  if ((pt->flags & PROTO_ILOOP))
+    lj_trace_forgetproto(g, pt);
+#endif
   lj_mem_free(g, pt, pt->sizept);
 }
 
@@ -25,6 +25,7 @@
 #endif
 #include "lj_trace.h"
 #include "lj_vm.h"
+#include "lj_usdt.h"
 
 #define GCSTEPSIZE	1024u
 #define GCSWEEPMAX	40
@@ -47,8 +48,9 @@
 #define gc_markobj(g, o) \
   { if (iswhite(obj2gco(o))) gc_mark(g, obj2gco(o)); }
 
-/* Mark a string object. */
-#define gc_mark_str(s)		((s)->marked &= (uint8_t)~LJ_GC_WHITES)
+/* Mark a string object. Don't touch it if it's already marked or frozen. */
+#define gc_mark_str(s) \
+  { if (((s)->marked & LJ_GC_WHITES)) (s)->marked &= (uint8_t)~LJ_GC_WHITES; }
 
 /* Mark a white GCobj. */
 static void gc_mark(global_State *g, GCobj *o)
@@ -74,6 +76,37 @@ static void gc_mark(global_State *g, GCobj *o)
   }
 }
 
+/* Add a frozen object to the remembered set. Must not throw. */
+static void gc_remember(global_State *g, GCobj *o)
+{
+  MSize n = g->gc.remnum;
+  lua_assert(isfrozen(o));
+  if (g->gc.frozen != GCFZremember)
+    return;  /* Full rescan pending. */
+  if (LJ_UNLIKELY(n >= g->gc.remsize)) {
+    MSize osz = g->gc.remsize, sz = osz ? osz*2 : 64;
+    GCRef *p = (GCRef *)g->allocf(g->allocd, mref(g->gc.rem, GCRef),
+				  osz*sizeof(GCRef), sz*sizeof(GCRef));
+    if (p == NULL) {  /* Out of memory? Rescan the frozen heap instead. */
+      g->gc.frozen = GCFZrescan;
+      return;
+    }
+    g->gc.total += (sz-osz)*(MSize)sizeof(GCRef);
+    setmref(g->gc.rem, p);
+    g->gc.remsize = sz;
+  }
+  setgcref(mref(g->gc.rem, GCRef)[n], o);
+  g->gc.remnum = n+1;
+}
+
+/* Remember frozen tables hit by the backward barrier before dropping them. */
+static void gc_remember_grayagain(global_State *g)
+{
+  GCobj *o;
+  for (o = gcref(g->gc.grayagain); o != NULL; o = gcref(o->gch.gclist))
+    if (isfrozen(o)) gc_remember(g, o);
+}
+
 /* Mark GC roots. */
 static void gc_mark_gcroot(global_State *g)
 {
@@ -86,6 +119,8 @@ static void gc_mark_gcroot(global_State *g)
 /* Start a GC cycle and mark the root set. */
 static void gc_mark_start(global_State *g)
 {
+  if (LJ_UNLIKELY(g->gc.frozen))
+    gc_remember_grayagain(g);
   setgcrefnull(g->gc.gray);
   setgcrefnull(g->gc.grayagain);
   setgcrefnull(g->gc.weak);
@@ -94,6 +129,7 @@ static void gc_mark_start(global_State *g)
   gc_marktv(g, &g->registrytv);
   gc_mark_gcroot(g);
   g->gc.state = GCSpropagate;
+  lj_usdt2(gc__start, g->gc.total, g->gc.threshold);
 }
 
 /* Mark open upvalues. */
@@ -252,7 +288,16 @@ static void gc_traverse_trace(global_State *g, GCtrace *T)
 }
 
 /* The current trace is a GC root while not anchored in the prototype (yet). */
-#define gc_traverse_curtrace(g)	gc_traverse_trace(g, &G2J(g)->cur)
+static void gc_traverse_curtrace(global_State *g)
+{
+  jit_State *J = G2J(g);
+  gc_traverse_trace(g, &J->cur);
+  if (J->cur.traceno != 0) {
+    MSize i;
+    for (i = 0; i < J->nrptr; i++)  /* Objects of cdata.rptr loads. */
+      gc_markobj(g, gcref(J->rptrcd[i]));
+  }
+}
 #else
 #define gc_traverse_curtrace(g)	UNUSED(g)
 #endif
@@ -311,6 +356,8 @@ static size_t propagatemark(global_State *g)
   setgcrefr(g->gc.gray, o->gch.gclist);  /* Remove from gray list. */
   if (LJ_LIKELY(gct == ~LJ_TTAB)) {
     GCtab *t = gco2tab(o);
+    if (LJ_UNLIKELY(isfrozen(o)))
+      gc_remember(g, o);  /* Written to since it was frozen. */
     if (gc_traverse_tab(g, t) > 0)
       black2gray(o);  /* Keep weak tables gray. */
     return sizeof(GCtab) + sizeof(TValue) * t->asize +
@@ -353,12 +400,174 @@ static size_t gc_propagate_gray(global_State *g)
   return m;
 }
 
+/* -- Frozen heap -------------------------------------------------------- */
+
+/* Mark an object referenced by a frozen object. Flag non-frozen objects. */
+#define gc_markfz(g, o, keep) \
+  { GCobj *x_ = (o); \
+    if (!isfrozen(x_)) { keep = 1; if (iswhite(x_)) gc_mark(g, x_); } }
+
+#define gc_markfztv(g, tv, keep) \
+  { if (tvisgcv(tv)) gc_markfz(g, gcV(tv), keep) }
+
+/* Traverse a frozen object in place and make it black again.
+** Returns 1 if it references any non-frozen objects, i.e. if it needs
+** to be remembered for the next GC cycle, too.
+*/
+static int gc_traverse_frozen(global_State *g, GCobj *o)
+{
+  int gct = o->gch.gct, keep = 0;
+  if (gct == ~LJ_TTAB) {
+    GCtab *t = gco2tab(o);
+    GCtab *mt = tabref(t->metatable);
+    cTValue *mode = lj_meta_fastg(g, mt, MM_mode);
+    if (mode && tvisstr(mode)) {  /* Became weak? Use the regular traversal. */
+      if (gc_traverse_tab(g, t) > 0) {
+	black2gray(o);  /* Keep weak tables gray. */
+	return 1;
+      }
+      keep = 1;
+    } else {
+      MSize i, asize = t->asize;
+      if (mt) gc_markfz(g, obj2gco(mt), keep)
+      for (i = 0; i < asize; i++)
+	gc_markfztv(g, arrayslot(t, i), keep)
+      if (t->hmask > 0) {
+	Node *node = noderef(t->node);
+	MSize hmask = t->hmask;
+	for (i = 0; i <= hmask; i++) {
+	  Node *n = &node[i];
+	  if (!tvisnil(&n->val)) {
+	    gc_markfztv(g, &n->key, keep)
+	    gc_markfztv(g, &n->val, keep)
+	  }
+	}
+      }
+    }
+  } else if (gct == ~LJ_TFUNC) {
+    GCfunc *fn = gco2func(o);
+    uint32_t i;
+    gc_markfz(g, obj2gco(tabref(fn->c.env)), keep)
+    if (isluafunc(fn)) {
+      gc_markfz(g, obj2gco(funcproto(fn)), keep)
+      for (i = 0; i < fn->l.nupvalues; i++)
+	gc_markfz(g, gcref(fn->l.uvptr[i]), keep)
+    } else {
+      for (i = 0; i < fn->c.nupvalues; i++)
+	gc_markfztv(g, &fn->c.upvalue[i], keep)
+    }
+  } else if (gct == ~LJ_TPROTO) {
+    GCproto *pt = gco2pt(o);
+    ptrdiff_t i;
+    gc_markfz(g, obj2gco(proto_chunkname(pt)), keep)
+    for (i = -(ptrdiff_t)pt->sizekgc; i < 0; i++)
+      gc_markfz(g, proto_kgc(pt, i), keep)
+#if LJ_HASJIT
+    if (pt->trace) {  /* Traces are never frozen. */
+      gc_marktrace(g, pt->trace);
+      keep = 1;
+    }
+#endif
+  } else if (gct == ~LJ_TUPVAL) {
+    gc_markfztv(g, uvval(gco2uv(o)), keep)
+  } else if (gct == ~LJ_TUDATA) {
+    GCtab *mt = tabref(gco2ud(o)->metatable);
+    if (mt) gc_markfz(g, obj2gco(mt), keep)
+    gc_markfz(g, obj2gco(tabref(gco2ud(o)->env)), keep)
+  }
+  if (!isblack(o))
+    gray2black(o);  /* Undo previous write barrier. */
+  return keep;
+}
+
+/* Sift down an entry of the remembered set heap. */
+static void gc_siftrem(GCRef *r, MSize j, MSize n)
+{
+  GCRef x = r[j];
+  MSize i;
+  for (; (i = 2*j+1) < n; j = i) {
+    if (i+1 < n && gcrefu(r[i+1]) > gcrefu(r[i])) i++;
+    if (gcrefu(r[i]) <= gcrefu(x)) break;
+    r[j] = r[i];
+  }
+  r[j] = x;
+}
+
+/* Sort the remembered set by address. Heapsort, to avoid recursion. */
+static void gc_sortrem(GCRef *r, MSize n)
+{
+  MSize j;
+  for (j = n/2; j-- > 0; )
+    gc_siftrem(r, j, n);
+  while (n > 1) {
+    GCRef x = r[--n];
+    r[n] = r[0];
+    r[0] = x;
+    gc_siftrem(r, 0, n);
+  }
+}
+
+/* Mark all objects referenced by frozen objects.
+**
+** Frozen objects are permanently black and never swept or traversed via
+** the gray list. Only the frozen objects which reference other objects are
+** kept in the remembered set. They are traversed in place at the start of
+** each GC cycle. Write barriers add frozen objects to it, too.
+*/
+static void gc_mark_frozen(global_State *g)
+{
+  GCobj *o;
+  if (g->gc.frozen == GCFZrescan) {  /* Rebuild the remembered set. */
+    g->gc.frozen = GCFZremember;
+    g->gc.remnum = 0;
+    for (o = gcref(g->gc.froot); o != NULL; o = gcnext(o))
+      if (gc_traverse_frozen(g, o)) gc_remember(g, o);
+    for (o = gcnext(obj2gco(mainthread(g))); o != NULL; o = gcnext(o))
+      if (isfrozen(o) && gc_traverse_frozen(g, o)) gc_remember(g, o);
+  } else {  /* Traverse each remembered object once. Drop unneeded ones. */
+    GCRef *rem = mref(g->gc.rem, GCRef);
+    GCobj *last = NULL;
+    MSize i, j = 0, n = g->gc.remnum;
+    gc_sortrem(rem, n);
+    for (i = 0; i < n; i++) {
+      o = gcref(rem[i]);
+      if (o != last && gc_traverse_frozen(g, o))
+	setgcref(rem[j++], o);
+      last = o;
+    }
+    g->gc.remnum = j;
+  }
+}
+
+/* Traverse frozen objects made gray by a forward write barrier. */
+static void gc_mark_frozengray(global_State *g)
+{
+  if (g->gc.frozen == GCFZrescan) {
+    GCobj *o;
+    for (o = gcref(g->gc.froot); o != NULL; o = gcnext(o))
+      if (!isblack(o) && o->gch.gct != ~LJ_TTAB)
+	gc_traverse_frozen(g, o);
+    for (o = gcnext(obj2gco(mainthread(g))); o != NULL; o = gcnext(o))
+      if (isfrozen(o) && !isblack(o))
+	gc_traverse_frozen(g, o);
+  } else {
+    GCRef *rem = mref(g->gc.rem, GCRef);
+    MSize i, n = g->gc.remnum;
+    for (i = 0; i < n; i++) {
+      GCobj *o = gcref(rem[i]);
+      if (!isblack(o) && o->gch.gct != ~LJ_TTAB)  /* Tables are in grayagain. */
+	gc_traverse_frozen(g, o);
+    }
+  }
+}
+
 /* -- Sweep phase --------------------------------------------------------- */
 
 /* Try to shrink some common data structures. */
 static void gc_shrink(global_State *g, lua_State *L)
 {
-  if (g->strnum <= (g->strmask >> 2) && g->strmask > LJ_MIN_STRTAB*2-1)
+  if (g->strnum <= (g->strmask >> 2) && g->strmask > LJ_MIN_STRTAB*2-1 &&
+      !g->gc.frozen)  /* Rehashing would touch all frozen strings. */
     lj_str_resize(L, g->strmask >> 1);  /* Shrink string table. */
   if (g->tmpbuf.sz > LJ_MIN_SBUF*2)
     lj_str_resizebuf(L, &g->tmpbuf, g->tmpbuf.sz >> 1);  /* Shrink temp buf. */
@@ -390,14 +599,19 @@ static const GCFreeFunc gc_freefunc[] = {
 
 /* Full sweep of a GC list. */
 #define gc_fullsweep(g, p)	gc_sweep(g, (p), LJ_MAX_MEM)
+#define gc_sweepdone(g, o) \
+  ((o) == NULL || (LJ_UNLIKELY((g)->gc.frozen) && isfrozen((o))))
 
 /* Partial sweep of a GC list. */
 static GCRef *gc_sweep(global_State *g, GCRef *p, uint32_t lim)
 {
   /* Mask with other white and LJ_GC_FIXED. Or LJ_GC_SFIXED on shutdown. */
   int ow = otherwhite(g);
+  int frozen = g->gc.frozen;
   GCobj *o;
   while ((o = gcref(*p)) != NULL && lim-- > 0) {
+    if (LJ_UNLIKELY(frozen) && isfrozen(o))
+      break;  /* Frozen objects form the tail of each list. Never touch them. */
     if (o->gch.gct == ~LJ_TTHREAD)  /* Need to sweep open upvalues, too. */
       gc_fullsweep(g, &gco2th(o)->openupval);
     if (((o->gch.marked ^ LJ_GC_WHITES) & ow)) {  /* Black or current white? */
@@ -504,14 +718,19 @@ static void gc_finalize(lua_State *L)
     setgcref(g->gc.root, o);
     makewhite(g, o);
     o->gch.marked &= (uint8_t)~LJ_GC_CDATA_FIN;
-    /* Resolve finalizer. */
+    /* Resolve finalizer. Lookup only, don't add a key for a missing entry. */
     setcdataV(L, &tmp, gco2cd(o));
-    tv = lj_tab_set(L, ctype_ctsG(g)->finalizer, &tmp);
+    tv = (TValue *)lj_tab_get(L, ctype_ctsG(g)->finalizer, &tmp);
     if (!tvisnil(tv)) {
       g->gc.nocdatafin = 0;
       copyTV(L, &tmp, tv);
       setnilV(tv);  /* Clear entry in finalizer table. */
       gc_call_finalizer(g, L, &tmp, o);
+    } else if ((mo = lj_ctype_meta(ctype_ctsG(g), gco2cd(o)->ctypeid,
+				   MM_gc))) {
+      /* Not in the finalizer table: use the __gc metamethod of the ctype. */
+      copyTV(L, &tmp, mo);
+      gc_call_finalizer(g, L, &tmp, o);
     }
     return;
   }
@@ -534,7 +753,10 @@ void lj_gc_finalize_udata(lua_State *L)
 }
 
 #if LJ_HASFFI
-/* Finalize all cdata objects from finalizer table. */
+/* Finalize all cdata objects from finalizer table.
+** The remaining cdata objects with a ctype __gc metamethod are moved to
+** the mmudata list and finalized by lj_gc_finalize_udata().
+*/
 void lj_gc_finalize_cdata(lua_State *L)
 {
   global_State *g = G(L);
@@ -542,18 +764,38 @@ void lj_gc_finalize_cdata(lua_State *L)
   if (cts) {
     GCtab *t = cts->finalizer;
     Node *node = noderef(t->node);
+    GCRef *p;
+    GCobj *o;
     ptrdiff_t i;
     setgcrefnull(t->metatable);  /* Mark finalizer table as disabled. */
     for (i = (ptrdiff_t)t->hmask; i >= 0; i--)
       if (!tvisnil(&node[i].val) && tviscdata(&node[i].key)) {
-	GCobj *o = gcV(&node[i].key);
 	TValue tmp;
+	o = gcV(&node[i].key);
 	makewhite(g, o);
 	o->gch.marked &= (uint8_t)~LJ_GC_CDATA_FIN;
 	copyTV(L, &tmp, &node[i].val);
 	setnilV(&node[i].val);
 	gc_call_finalizer(g, L, &tmp, o);
       }
+    for (p = &g->gc.root; (o = gcref(*p)) != NULL; ) {
+      if (o->gch.gct == ~LJ_TCDATA && (o->gch.marked & LJ_GC_CDATA_FIN)) {
+	GCobj *root = gcref(g->gc.mmudata);
+	setgcrefr(*p, o->gch.nextgc);  /* Unlink from root list. */
+	makewhite(g, o);
+	markfinalized(o);
+	/* Append to end of mmudata list. */
+	if (root) {
+	  setgcrefr(o->gch.nextgc, root->gch.nextgc);
+	  setgcref(root->gch.nextgc, o);
+	} else {
+	  setgcref(o->gch.nextgc, o);
+	}
+	setgcref(g->gc.mmudata, o);
+      } else {
+	p = &o->gch.nextgc;
+      }
+    }
   }
 }
 #endif
@@ -564,7 +806,10 @@ void lj_gc_freeall(global_State *g)
   MSize i, strmask;
   /* Free everything, except super-fixed objects (the main thread). */
   g->gc.currentwhite = LJ_GC_WHITES | LJ_GC_SFIXED;
+  g->gc.frozen = GCFZnone;
   gc_fullsweep(g, &g->gc.root);
+  gc_fullsweep(g, &g->gc.froot);
+  lj_mem_freevec(g, mref(g->gc.rem, GCRef), g->gc.remsize, GCRef);
   strmask = g->strmask;
   for (i = 0; i <= strmask; i++)  /* Free all string hash chains. */
     gc_fullsweep(g, &g->strhash[i]);
@@ -577,7 +822,10 @@ static void atomic(global_State *g, lua_State *L)
 {
   size_t udsize;
 
+  lj_usdt1(gc__atomic, g->gc.total);
   gc_mark_uv(g);  /* Need to remark open upvalues (the thread may be dead). */
+  if (g->gc.frozen)
+    gc_mark_frozengray(g);  /* Need to remark frozen objects written to. */
   gc_propagate_gray(g);  /* Propagate any left-overs. */
 
   setgcrefr(g->gc.gray, g->gc.weak);  /* Empty the list of weak tables. */
@@ -613,6 +861,8 @@ static size_t gc_onestep(lua_State *L)
   switch (g->gc.state) {
   case GCSpause:
     gc_mark_start(g);  /* Start a new GC cycle by marking all GC roots. */
+    if (g->gc.frozen)
+      gc_mark_frozen(g);  /* The frozen heap is part of the root set. */
     return 0;
   case GCSpropagate:
     if (gcref(g->gc.gray) != NULL)
@@ -640,7 +890,7 @@ static size_t gc_onestep(lua_State *L)
     setmref(g->gc.sweep, gc_sweep(g, mref(g->gc.sweep, GCRef), GCSWEEPMAX));
     lua_assert(old >= g->gc.total);
     g->gc.estimate -= old - g->gc.total;
-    if (gcref(*mref(g->gc.sweep, GCRef)) == NULL) {
+    if (gc_sweepdone(g, gcref(*mref(g->gc.sweep, GCRef)))) {
       gc_shrink(g, L);
       if (gcref(g->gc.mmudata)) {  /* Need any finalizations? */
 	g->gc.state = GCSfinalize;
@@ -650,6 +900,10 @@ static size_t gc_onestep(lua_State *L)
       } else {  /* Otherwise skip this phase to help the JIT. */
 	g->gc.state = GCSpause;  /* End of GC cycle. */
 	g->gc.debt = 0;
+#if LJ_HASJIT
+	lj_trace_cooldown(G2J(g));
+#endif
+	lj_usdt2(gc__end, g->gc.total, g->gc.estimate);
       }
     }
     return GCSWEEPMAX*GCSWEEPCOST;
@@ -668,6 +922,10 @@ static size_t gc_onestep(lua_State *L)
 #endif
     g->gc.state = GCSpause;  /* End of GC cycle. */
     g->gc.debt = 0;
+#if LJ_HASJIT
+    lj_trace_cooldown(G2J(g));
+#endif
+    lj_usdt2(gc__end, g->gc.total, g->gc.estimate);
     return 0;
   default:
     lua_assert(0);
@@ -736,6 +994,8 @@ void lj_gc_fullgc(lua_State *L)
   setvmstate(g, GC);
   if (g->gc.state <= GCSatomic) {  /* Caught somewhere in the middle. */
     setmref(g->gc.sweep, &g->gc.root);  /* Sweep everything (preserving it). */
+    if (g->gc.frozen)
+      gc_remember_grayagain(g);
     setgcrefnull(g->gc.gray);  /* Reset lists from partial propagation. */
     setgcrefnull(g->gc.grayagain);
     setgcrefnull(g->gc.weak);
@@ -752,14 +1012,74 @@ void lj_gc_fullgc(lua_State *L)
   g->vmstate = ostate;
 }
 
+/* Check whether an object can be frozen. */
+static int gc_mayfreeze(global_State *g, GCobj *o)
+{
+  int gct = o->gch.gct;
+  if (gct == ~LJ_TTHREAD || gct == ~LJ_TTRACE)
+    return 0;  /* These need a full traversal in every cycle. */
+  if (gct == ~LJ_TCDATA)
+    return 0;  /* No spare bit in the marked field. */
+  if (gct == ~LJ_TTAB) {
+    cTValue *mode = lj_meta_fastg(g, tabref(gco2tab(o)->metatable), MM_mode);
+    if (mode && tvisstr(mode))
+      return 0;  /* Weak tables must be cleared in every cycle. */
+  }
+  return 1;
+}
+
+/* Make an object frozen. */
+#define gc_freezeobj(o) \
+  ((o)->gch.marked = (uint8_t)(((o)->gch.marked & ~LJ_GC_COLORS) | \
+			       LJ_GC_BLACK | LJ_GC_FROZEN))
+
+/* Freeze all live objects, e.g. before forking worker processes.
+**
+** Frozen objects are never collected. They are moved to a separate list,
+** which is never swept. The GC only reads them from now on, except for the
+** ones which are written to, so memory pages shared after fork() are not
+** copied by the GC itself.
+*/
+void lj_gc_freeze(lua_State *L)
+{
+  global_State *g = G(L);
+  GCobj *o, *mainth = obj2gco(mainthread(g));
+  GCRef *p = &g->gc.root;
+  MSize i;
+  lj_gc_fullgc(L);
+  lua_assert(g->gc.state == GCSpause);
+  while ((o = gcref(*p)) != mainth) {  /* Move to the list of frozen objects. */
+    if (gc_mayfreeze(g, o)) {
+      setgcrefr(*p, o->gch.nextgc);
+      setgcrefr(o->gch.nextgc, g->gc.froot);
+      setgcref(g->gc.froot, o);
+      gc_freezeobj(o);
+    } else {
+      p = &o->gch.nextgc;
+    }
+  }
+  for (o = gcnext(mainth); o != NULL; o = gcnext(o))  /* Userdata. */
+    gc_freezeobj(o);
+  for (i = 0; i <= g->strmask; i++)
+    for (o = gcref(g->strhash[i]); o != NULL; o = gcnext(o))
+      gc_freezeobj(o);
+  g->gc.frozen = GCFZrescan;  /* Build the remembered set in the next cycle. */
+}
+
 /* -- Write barriers ------------------------------------------------------ */
 
 /* Move the GC propagation frontier forward. */
 void lj_gc_barrierf(global_State *g, GCobj *o, GCobj *v)
 {
   lua_assert(isblack(o) && iswhite(v) && !isdead(g, v) && !isdead(g, o));
-  lua_assert(g->gc.state != GCSfinalize && g->gc.state != GCSpause);
+  lua_assert((g->gc.state != GCSfinalize && g->gc.state != GCSpause) ||
+	     isfrozen(o));
   lua_assert(o->gch.gct != ~LJ_TTAB);
+  if (LJ_UNLIKELY(isfrozen(o))) {  /* Traverse it in the atomic phase. */
+    black2gray(o);  /* Make it gray to avoid the following barrier. */
+    gc_remember(g, o);
+    return;
+  }
   /* Preserve invariant during propagation. Otherwise it doesn't matter. */
   if (g->gc.state == GCSpropagate || g->gc.state == GCSatomic)
     gc_mark(g, v);  /* Move frontier forward. */
@@ -772,7 +1092,10 @@ void LJ_FASTCALL lj_gc_barrieruv(global_State *g, TValue *tv)
 {
 #define TV2MARKED(x) \
   (*((uint8_t *)(x) - offsetof(GCupval, tv) + offsetof(GCupval, marked)))
-  if (g->gc.state == GCSpropagate || g->gc.state == GCSatomic)
+  if (LJ_UNLIKELY(TV2MARKED(tv) & LJ_GC_FROZEN)) {  /* See above. */
+    TV2MARKED(tv) &= (uint8_t)~LJ_GC_BLACK;
+    gc_remember(g, (GCobj *)((char *)tv - offsetof(GCupval, tv)));
+  } else if (g->gc.state == GCSpropagate || g->gc.state == GCSatomic)
     gc_mark(g, gcV(tv));
   else
     TV2MARKED(tv) = (TV2MARKED(tv) & (uint8_t)~LJ_GC_COLORS) | curwhite(g);
@@ -805,6 +1128,11 @@ void lj_gc_closeuv(global_State *g, GCupval *uv)
 /* Mark a trace if it's saved during the propagation phase. */
 void lj_gc_barriertrace(global_State *g, uint32_t traceno)
 {
+  GCobj *pt = gcref(traceref(G2J(g), traceno)->startpt);
+  if (LJ_UNLIKELY(isfrozen(pt)) && isblack(pt)) {  /* Anchored in frozen pt? */
+    black2gray(pt);
+    gc_remember(g, pt);
+  }
   if (g->gc.state == GCSpropagate || g->gc.state == GCSatomic)
     gc_marktrace(g, traceno);
 }
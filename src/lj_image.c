@@ -0,0 +1,1003 @@
+/*
+** Heap image writer and reader.
+** Copyright (C) 2005-2021 Mike Pall. See Copyright Notice in luajit.h
+*/
+
+#define lj_image_c
+#define LUA_CORE
+
+#include "lj_obj.h"
+#include "lj_gc.h"
+#include "lj_err.h"
+#include "lj_str.h"
+#include "lj_tab.h"
+#include "lj_func.h"
+#include "lj_state.h"
+#include "lj_meta.h"
+#include "lj_bcdump.h"
+#if LJ_HASFFI
+#include "lj_ctype.h"
+#include "lj_cdata.h"
+#endif
+#include "lj_vm.h"
+#include "lj_image.h"
+
+/*
+** A heap image holds all objects reachable from package.loaded, i.e. the
+** loaded modules and the globals. Reading it recreates these objects in
+** another state, without running any of the code which created them.
+**
+** The objects are rebuilt one by one. Mapping the heap itself is not an
+** option: objects hold absolute pointers (which must be in the lower 4GB
+** on x64), strings must be interned in the string hash table and the
+** hash parts of tables are chained by pointers.
+**
+** Library objects (modules, C functions, userdata) are not saved. They
+** are referenced by their table and key and looked up in the state which
+** reads the image. The contents of module tables are merged into the
+** existing tables. Anything else which can't be recreated from its
+** contents alone, like threads or cdata holding pointers, is an error.
+*/
+
+/* Get the package.loaded table. */
+static GCtab *image_loaded(lua_State *L)
+{
+  cTValue *tv = lj_tab_getstr(tabV(registry(L)), lj_str_newlit(L, "_LOADED"));
+  if (!tv || !tvistab(tv))
+    lj_err_callerv(L, LJ_ERR_IMGEXT, "package.loaded");
+  return tabV(tv);
+}
+
+/* Get the next used slot of a table. Returns NULL at the end. */
+static cTValue *image_next(lua_State *L, GCtab *t, MSize *idx, TValue *key)
+{
+  MSize i = *idx;
+  for (; i < t->asize; i++) {
+    cTValue *o = arrayslot(t, i);
+    if (!tvisnil(o)) {
+      setintV(key, (int32_t)i);
+      *idx = i+1;
+      return o;
+    }
+  }
+  for (i -= t->asize; i <= t->hmask; i++) {
+    Node *n = &noderef(t->node)[i];
+    if (!tvisnil(&n->val)) {
+      copyTV(L, key, &n->key);
+      *idx = t->asize+i+1;
+      return &n->val;
+    }
+  }
+  *idx = t->asize+i;
+  return NULL;
+}
+
+/* Compute the FNV-1a hash of the data after the header. */
+static uint32_t image_check(const uint8_t *p, MSize len)
+{
+  uint32_t h = 2166136261u;
+  for (; len > 0; len--)
+    h = (h ^ *p++) * 16777619u;
+  return h;
+}
+
+/* -- Heap image writer --------------------------------------------------- */
+
+/* Context for heap image writer. */
+typedef struct ImgWriteCtx {
+  SBuf sb;			/* Output buffer. */
+  SBuf pb;			/* Buffer for bytecode dumps. */
+  lua_State *L;			/* Lua state. */
+  GCtab *loaded;		/* Root object: the package.loaded table. */
+  GCtab *ext;			/* Map of library objects to their parent. */
+  GCtab *ids;			/* Map of objects to object IDs. */
+  GCtab *objs;			/* Array of objects, indexed by object ID. */
+  MSize nobj;			/* Number of objects. */
+} ImgWriteCtx;
+
+/* Need a certain amount of buffer space. */
+static LJ_AINLINE void imgw_need(ImgWriteCtx *ctx, MSize len)
+{
+  if (LJ_UNLIKELY(ctx->sb.n + len > ctx->sb.sz)) {
+    MSize sz = ctx->sb.sz * 2;
+    while (ctx->sb.n + len > sz) sz = sz * 2;
+    lj_str_resizebuf(ctx->L, &ctx->sb, sz);
+  }
+}
+
+/* Add memory block to buffer. */
+static void imgw_block(ImgWriteCtx *ctx, const void *p, MSize len)
+{
+  imgw_need(ctx, len);
+  memcpy(ctx->sb.buf + ctx->sb.n, p, len);
+  ctx->sb.n += len;
+}
+
+/* Store a 32 bit little-endian value. */
+static void imgw_word(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+}
+
+/* Add ULEB128 value to buffer. */
+static void imgw_uleb128(ImgWriteCtx *ctx, uint32_t v)
+{
+  MSize n;
+  uint8_t *p;
+  imgw_need(ctx, 5);
+  n = ctx->sb.n;
+  p = (uint8_t *)ctx->sb.buf;
+  for (; v >= 0x80; v >>= 7)
+    p[n++] = (uint8_t)((v & 0x7f) | 0x80);
+  p[n++] = (uint8_t)v;
+  ctx->sb.n = n;
+}
+
+/* Get the ID of an object. Returns 0 if it has none yet. */
+static MSize imgw_id(ImgWriteCtx *ctx, cTValue *o)
+{
+  cTValue *tv = lj_tab_get(ctx->L, ctx->ids, o);
+  return tvisnil(tv) ? 0 : (MSize)numberVint(tv);
+}
+
+/* Check for values which are only found in libraries. */
+#define imgw_islib(o) \
+  ((tvisfunc(o) && !isluafunc(funcV(o))) || tvisudata(o))
+
+/* Add a location of a library object. Tables only get their first one. */
+static void imgw_addext(ImgWriteCtx *ctx, cTValue *o, GCtab *parent,
+			cTValue *key)
+{
+  lua_State *L = ctx->L;
+  TValue *tv = lj_tab_set(L, ctx->ext, o);
+  GCtab *loc;
+  MSize n;
+  if (tvisnil(tv)) {
+    loc = lj_tab_new(L, 2, 0);
+    settabV(L, tv, loc);
+    lj_gc_anybarriert(L, ctx->ext);
+  } else if (tvistab(o)) {
+    return;
+  } else {
+    loc = tabV(tv);
+  }
+  n = (MSize)lj_tab_len(loc);
+  settabV(L, lj_tab_setint(L, loc, (int32_t)n+1), parent);
+  copyTV(L, lj_tab_setint(L, loc, (int32_t)n+2), key);
+  lj_gc_anybarriert(L, loc);
+}
+
+/* Check whether a table holds any library values. */
+static int imgw_haslib(lua_State *L, GCtab *t)
+{
+  TValue key;
+  cTValue *o;
+  MSize i = 0;
+  while ((o = image_next(L, t, &i, &key)) != NULL)
+    if (imgw_islib(o)) return 1;
+  return 0;
+}
+
+/* Add all library values of a table. */
+static void imgw_addlib(ImgWriteCtx *ctx, GCtab *t)
+{
+  TValue key;
+  cTValue *o;
+  MSize i = 0;
+  while ((o = image_next(ctx->L, t, &i, &key)) != NULL)
+    if (imgw_islib(o)) imgw_addext(ctx, o, t, &key);
+}
+
+/* Collect the library objects and their locations. These are the modules
+** in package.loaded, the tables in modules holding C functions or userdata,
+** e.g. package.loaders, and the C functions and userdata in both of them.
+** A C function is often found in more than one place, e.g. in a module and
+** in the globals. All of them are saved and the first one which resolves
+** in the loading state is used.
+*/
+static void imgw_findext(ImgWriteCtx *ctx)
+{
+  lua_State *L = ctx->L;
+  GCtab *loaded = ctx->loaded;
+  TValue k1, k2;
+  cTValue *m, *o;
+  MSize i, j;
+  for (i = 0; (m = image_next(L, loaded, &i, &k1)) != NULL; )
+    if (tvistab(m)) imgw_addext(ctx, m, loaded, &k1);
+  for (i = 0; (m = image_next(L, loaded, &i, &k1)) != NULL; )
+    if (tvistab(m))
+      for (j = 0; (o = image_next(L, tabV(m), &j, &k2)) != NULL; )
+	if (tvistab(o) && imgw_haslib(L, tabV(o)))
+	  imgw_addext(ctx, o, tabV(m), &k2);
+  for (i = 0; (m = image_next(L, loaded, &i, &k1)) != NULL; ) {
+    if (!tvistab(m)) continue;
+    imgw_addlib(ctx, tabV(m));
+    for (j = 0; (o = image_next(L, tabV(m), &j, &k2)) != NULL; ) {
+      cTValue *loc = lj_tab_get(L, ctx->ext, o);
+      if (tvistab(o) && tvistab(loc) &&
+	  tabV(lj_tab_getint(tabV(loc), 1)) == tabV(m))
+	imgw_addlib(ctx, tabV(o));
+    }
+  }
+}
+
+#if LJ_HASFFI
+/* Check whether the contents of a cdata object can be copied as is. */
+static int imgw_ctsafe(CTState *cts, CTypeID id)
+{
+  CType *ct = ctype_raw(cts, id);
+  if (ctype_isnum(ct->info) || ctype_isenum(ct->info))
+    return 1;
+  if ((ct->info & CTF_VLA) || ct->size == CTSIZE_INVALID)
+    return 0;
+  if (ctype_isarray(ct->info))  /* Also handles complex and vector types. */
+    return imgw_ctsafe(cts, ctype_cid(ct->info));
+  if (ctype_isstruct(ct->info)) {
+    while (ct->sib) {
+      ct = ctype_get(cts, ct->sib);
+      if (ctype_isfield(ct->info) && !imgw_ctsafe(cts, ctype_cid(ct->info)))
+	return 0;
+    }
+    return 1;
+  }
+  return 0;  /* Pointers, references and functions hold addresses. */
+}
+#endif
+
+/* Check whether a new object can be saved. */
+static void imgw_check(ImgWriteCtx *ctx, cTValue *o)
+{
+  lua_State *L = ctx->L;
+  if (tvisfunc(o) && !isluafunc(funcV(o)))
+    lj_err_callerv(L, LJ_ERR_IMGSAVE, "C function");
+  if (tvisthread(o) || tvisudata(o))
+    lj_err_callerv(L, LJ_ERR_IMGSAVE, lj_typename(o));
+#if LJ_HASFFI
+  if (tviscdata(o)) {
+    CTState *cts = ctype_cts(L);
+    GCcdata *cd = cdataV(o);
+    if (cdataisv(cd) || !imgw_ctsafe(cts, cd->ctypeid) ||
+	!tvisnil(lj_tab_get(L, cts->finalizer, o)))
+      lj_err_callerv(L, LJ_ERR_IMGSAVE,
+		     strdata(lj_ctype_repr(L, cd->ctypeid, NULL)));
+  }
+#endif
+}
+
+/* Assign an ID to a new object and queue it for traversal. */
+static void imgw_mark(ImgWriteCtx *ctx, cTValue *o)
+{
+  lua_State *L = ctx->L;
+  if (tvisgcv(o)) {
+    cTValue *loc;
+    TValue *tv;
+    if (imgw_id(ctx, o))
+      return;
+    loc = lj_tab_get(L, ctx->ext, o);
+    if (tvistab(loc)) {  /* Library object: locations go first. */
+      GCtab *t = tabV(loc);
+      MSize i, n = (MSize)lj_tab_len(t);
+      for (i = 1; i <= n; i++)
+	imgw_mark(ctx, lj_tab_getint(t, (int32_t)i));
+    } else if (gcV(o) != obj2gco(ctx->loaded)) {
+      imgw_check(ctx, o);
+    }
+    tv = lj_tab_set(L, ctx->ids, o);
+    setintV(tv, (int32_t)++ctx->nobj);
+    copyTV(L, lj_tab_setint(L, ctx->objs, (int32_t)ctx->nobj), o);
+    lj_gc_anybarriert(L, ctx->ids);
+    lj_gc_anybarriert(L, ctx->objs);
+  } else if (tvislightud(o)) {
+    lj_err_callerv(L, LJ_ERR_IMGSAVE, lj_typename(o));
+  }
+}
+
+/* Assign IDs to all reachable objects. */
+static void imgw_traverse(ImgWriteCtx *ctx)
+{
+  lua_State *L = ctx->L;
+  MSize id;
+  for (id = 1; id <= ctx->nobj; id++) {
+    cTValue *o = lj_tab_getint(ctx->objs, (int32_t)id);
+    if (imgw_islib(o))
+      continue;  /* Library values are not traversed. */
+    if (tvistab(o)) {
+      GCtab *t = tabV(o), *mt = tabref(t->metatable);
+      TValue key;
+      cTValue *v;
+      MSize i = 0;
+      if (mt) {
+	TValue tmp;
+	settabV(L, &tmp, mt);
+	imgw_mark(ctx, &tmp);
+      }
+      while ((v = image_next(L, t, &i, &key)) != NULL) {
+	imgw_mark(ctx, &key);
+	imgw_mark(ctx, v);
+      }
+    } else if (tvisfunc(o)) {
+      GCfunc *fn = funcV(o);
+      TValue tmp;
+      uint32_t i;
+      settabV(L, &tmp, tabref(fn->l.env));
+      imgw_mark(ctx, &tmp);
+      setprotoV(L, &tmp, funcproto(fn));
+      imgw_mark(ctx, &tmp);
+      for (i = 0; i < fn->l.nupvalues; i++) {
+	setgcV(L, &tmp, gcref(fn->l.uvptr[i]), LJ_TUPVAL);
+	imgw_mark(ctx, &tmp);
+      }
+    } else if (itype(o) == LJ_TUPVAL) {
+      imgw_mark(ctx, uvval(gco2uv(gcV(o))));
+    }
+  }
+}
+
+/* Write a value. */
+static void imgw_value(ImgWriteCtx *ctx, cTValue *o)
+{
+  if (tvisnil(o)) {
+    imgw_uleb128(ctx, IMG_V_NIL);
+  } else if (tvisbool(o)) {
+    imgw_uleb128(ctx, tvistrue(o) ? IMG_V_TRUE : IMG_V_FALSE);
+  } else if (tvisnumber(o)) {
+    TValue tmp;
+    setnumV(&tmp, numberVnum(o));
+    imgw_uleb128(ctx, IMG_V_NUM);
+    imgw_uleb128(ctx, tmp.u32.lo);
+    imgw_uleb128(ctx, tmp.u32.hi);
+  } else {
+    MSize id = imgw_id(ctx, o);
+    lua_assert(id != 0);
+    imgw_uleb128(ctx, IMG_V_NUM + id);
+  }
+}
+
+/* Writer callback for bytecode dumps. */
+static int imgw_bcwriter(lua_State *L, const void *p, size_t sz, void *ud)
+{
+  SBuf *pb = (SBuf *)ud;
+  char *q = lj_str_needbuf(L, pb, pb->n + (MSize)sz);
+  memcpy(q + pb->n, p, sz);
+  pb->n += (MSize)sz;
+  return 0;
+}
+
+/* Write the shell of an object, i.e. all data needed to create it. */
+static void imgw_shell(ImgWriteCtx *ctx, cTValue *o)
+{
+  lua_State *L = ctx->L;
+  cTValue *loc = lj_tab_get(L, ctx->ext, o);
+  if (gcV(o) == obj2gco(ctx->loaded)) {
+    imgw_uleb128(ctx, IMG_OBJ_LOADED);
+  } else if (tvistab(loc)) {
+    GCtab *t = tabV(loc);
+    MSize i, n = (MSize)lj_tab_len(t);
+    imgw_uleb128(ctx, IMG_OBJ_EXT);
+    imgw_uleb128(ctx, n/2);
+    for (i = 1; i <= n; i += 2) {
+      imgw_uleb128(ctx, imgw_id(ctx, lj_tab_getint(t, (int32_t)i)));
+      imgw_value(ctx, lj_tab_getint(t, (int32_t)i+1));
+    }
+    imgw_uleb128(ctx, ~itype(o));
+  } else if (tvisstr(o)) {
+    GCstr *s = strV(o);
+    imgw_uleb128(ctx, IMG_OBJ_STR);
+    imgw_uleb128(ctx, s->len);
+    imgw_block(ctx, strdata(s), s->len);
+  } else if (tvistab(o)) {
+    GCtab *t = tabV(o);
+    imgw_uleb128(ctx, IMG_OBJ_TAB);
+    imgw_uleb128(ctx, t->asize);
+    imgw_uleb128(ctx, t->hmask ? lj_fls(t->hmask+1) : 0);
+  } else if (tvisproto(o)) {
+    int status;
+    lj_str_resetbuf(&ctx->pb);
+    status = lj_bcwrite(L, protoV(o), imgw_bcwriter, &ctx->pb, 0);
+    if (status) lj_err_throw(L, status);
+    imgw_uleb128(ctx, IMG_OBJ_PROTO);
+    imgw_uleb128(ctx, ctx->pb.n);
+    imgw_block(ctx, ctx->pb.buf, ctx->pb.n);
+  } else if (tvisfunc(o)) {
+    GCfunc *fn = funcV(o);
+    TValue tmp;
+    uint32_t i;
+    imgw_uleb128(ctx, IMG_OBJ_FUNC);
+    setprotoV(L, &tmp, funcproto(fn));
+    imgw_uleb128(ctx, imgw_id(ctx, &tmp));
+    imgw_uleb128(ctx, fn->l.nupvalues);
+    for (i = 0; i < fn->l.nupvalues; i++) {
+      setgcV(L, &tmp, gcref(fn->l.uvptr[i]), LJ_TUPVAL);
+      imgw_uleb128(ctx, imgw_id(ctx, &tmp));
+    }
+  } else if (itype(o) == LJ_TUPVAL) {
+    imgw_uleb128(ctx, IMG_OBJ_UPVAL);
+#if LJ_HASFFI
+  } else if (tviscdata(o)) {
+    GCcdata *cd = cdataV(o);
+    CTSize sz = lj_ctype_size(ctype_cts(L), cd->ctypeid);
+    imgw_uleb128(ctx, IMG_OBJ_CDATA);
+    imgw_uleb128(ctx, cd->ctypeid);
+    imgw_uleb128(ctx, sz);
+    imgw_block(ctx, cdataptr(cd), sz);
+#endif
+  } else {
+    lua_assert(0);
+  }
+}
+
+/* Write the fill of an object, i.e. the references to other objects. */
+static void imgw_fill(ImgWriteCtx *ctx, cTValue *o)
+{
+  lua_State *L = ctx->L;
+  if (tvistab(o)) {
+    GCtab *t = tabV(o), *mt = tabref(t->metatable);
+    TValue key;
+    cTValue *v;
+    MSize i = 0, n = 0;
+    if (mt) {
+      TValue tmp;
+      settabV(L, &tmp, mt);
+      imgw_value(ctx, &tmp);
+    } else {
+      imgw_uleb128(ctx, IMG_V_NIL);
+    }
+    while (image_next(L, t, &i, &key) != NULL) n++;
+    imgw_uleb128(ctx, n);
+    for (i = 0; (v = image_next(L, t, &i, &key)) != NULL; ) {
+      imgw_value(ctx, &key);
+      imgw_value(ctx, v);
+    }
+  } else if (tvisfunc(o) && isluafunc(funcV(o))) {
+    TValue tmp;
+    settabV(L, &tmp, tabref(funcV(o)->l.env));
+    imgw_value(ctx, &tmp);
+  } else if (itype(o) == LJ_TUPVAL) {
+    imgw_value(ctx, uvval(gco2uv(gcV(o))));
+  }
+}
+
+#if LJ_HASFFI
+/* Write the C types added after the predefined ones. The hash chains
+** depend on string addresses, so only a flag for chained types is saved.
+*/
+static void imgw_ctypes(ImgWriteCtx *ctx)
+{
+  CTState *cts = ctype_ctsG(G(ctx->L));
+  CTypeID id, base = lj_ctype_numpredef();
+  uint8_t *hashed;
+  MSize i;
+  if (!cts || cts->top == base) {
+    imgw_uleb128(ctx, 0);
+    return;
+  }
+  hashed = (uint8_t *)lj_str_needbuf(ctx->L, &ctx->pb, cts->top);
+  memset(hashed, 0, cts->top);
+  for (i = 0; i < CTHASH_SIZE; i++)
+    for (id = cts->hash[i]; id; id = ctype_get(cts, id)->next)
+      hashed[id] = 1;
+  imgw_uleb128(ctx, cts->top - base);
+  for (id = base; id < cts->top; id++) {
+    CType *ct = ctype_get(cts, id);
+    GCstr *name = gcrefp(ct->name, GCstr);
+    imgw_uleb128(ctx, ct->info);
+    imgw_uleb128(ctx, ct->size);
+    imgw_uleb128(ctx, ct->sib);
+    imgw_uleb128(ctx, hashed[id]);
+    if (name) {
+      imgw_uleb128(ctx, name->len+1);
+      imgw_block(ctx, strdata(name), name->len);
+    } else {
+      imgw_uleb128(ctx, 0);
+    }
+  }
+}
+
+/* Write the metatables associated with C types by ffi.metatype(). */
+static void imgw_metatypes(ImgWriteCtx *ctx, int mark)
+{
+  lua_State *L = ctx->L;
+  CTState *cts = ctype_ctsG(G(L));
+  TValue key;
+  cTValue *v;
+  MSize i, n = 0;
+  if (!cts) {
+    if (!mark) imgw_uleb128(ctx, 0);
+    return;
+  }
+  for (i = 0; (v = image_next(L, cts->miscmap, &i, &key)) != NULL; )
+    if (tvisnumber(&key) && numberVnum(&key) < 0) {
+      if (mark) imgw_mark(ctx, v); else n++;
+    }
+  if (mark) return;
+  imgw_uleb128(ctx, n);
+  for (i = 0; (v = image_next(L, cts->miscmap, &i, &key)) != NULL; )
+    if (tvisnumber(&key) && numberVnum(&key) < 0) {
+      imgw_uleb128(ctx, (uint32_t)-numberVint(&key));
+      imgw_value(ctx, v);
+    }
+}
+#endif
+
+/* Protected callback for heap image writer. */
+static TValue *cpimagewrite(lua_State *L, lua_CFunction dummy, void *ud)
+{
+  ImgWriteCtx *ctx = (ImgWriteCtx *)ud;
+  TValue tmp;
+  MSize id, data;
+  UNUSED(dummy);
+  ctx->loaded = image_loaded(L);
+  ctx->ext = lj_tab_new(L, 0, 0);
+  settabV(L, L->top++, ctx->ext);
+  ctx->ids = lj_tab_new(L, 0, 0);
+  settabV(L, L->top++, ctx->ids);
+  ctx->objs = lj_tab_new(L, 0, 0);
+  settabV(L, L->top++, ctx->objs);
+  incr_top(L);  /* Ensure stack space for the anchors. */
+  L->top--;
+  imgw_findext(ctx);
+  settabV(L, &tmp, ctx->loaded);
+  imgw_mark(ctx, &tmp);
+#if LJ_HASFFI
+  imgw_metatypes(ctx, 1);
+#endif
+  imgw_traverse(ctx);
+  lj_str_resizebuf(L, &ctx->sb, 65536);
+  ctx->sb.buf[0] = IMG_HEAD1;
+  ctx->sb.buf[1] = IMG_HEAD2;
+  ctx->sb.buf[2] = IMG_HEAD3;
+  ctx->sb.n = 3;
+  imgw_uleb128(ctx, IMG_VERSION);
+  imgw_uleb128(ctx, (LJ_BE ? IMG_F_BE : 0) + (LJ_HASFFI ? IMG_F_FFI : 0));
+  imgw_need(ctx, 8);
+  ctx->sb.n += 8;  /* Size and check are filled in at the end. */
+  data = ctx->sb.n;
+  imgw_uleb128(ctx, ctx->nobj);
+#if LJ_HASFFI
+  imgw_ctypes(ctx);
+#else
+  imgw_uleb128(ctx, 0);
+#endif
+  for (id = 1; id <= ctx->nobj; id++)
+    imgw_shell(ctx, lj_tab_getint(ctx->objs, (int32_t)id));
+  for (id = 1; id <= ctx->nobj; id++)
+    imgw_fill(ctx, lj_tab_getint(ctx->objs, (int32_t)id));
+#if LJ_HASFFI
+  imgw_metatypes(ctx, 0);
+#else
+  imgw_uleb128(ctx, 0);
+#endif
+  imgw_word((uint8_t *)ctx->sb.buf + data-8, ctx->sb.n - data);
+  imgw_word((uint8_t *)ctx->sb.buf + data-4,
+	    image_check((const uint8_t *)ctx->sb.buf + data, ctx->sb.n - data));
+  L->top -= 3;  /* Drop the anchors before calling the writer. */
+  return NULL;
+}
+
+/* Write a heap image. */
+int lj_image_write(lua_State *L, lua_Writer writer, void *data)
+{
+  ImgWriteCtx ctx;
+  int status;
+  ctx.L = L;
+  ctx.nobj = 0;
+  lj_str_initbuf(&ctx.sb);
+  lj_str_initbuf(&ctx.pb);
+  lj_str_resetbuf(&ctx.sb);
+  lj_str_resetbuf(&ctx.pb);
+  status = lj_vm_cpcall(L, NULL, &ctx, cpimagewrite);
+  if (status == 0)
+    status = writer(L, ctx.sb.buf, ctx.sb.n, data);
+  lj_str_freebuf(G(L), &ctx.sb);
+  lj_str_freebuf(G(L), &ctx.pb);
+  return status;
+}
+
+/* -- Heap image reader --------------------------------------------------- */
+
+/* Context for heap image reader. */
+typedef struct ImgReadCtx {
+  lua_State *L;			/* Lua state. */
+  const uint8_t *p;		/* Current position. */
+  const uint8_t *pe;		/* End of image. */
+  GCtab *objs;			/* Array of objects, indexed by object ID. */
+  MSize nobj;			/* Number of objects. */
+} ImgReadCtx;
+
+/* Throw reader error. */
+static LJ_NOINLINE void imgr_error(ImgReadCtx *ctx)
+{
+  lj_err_caller(ctx->L, LJ_ERR_IMGBAD);
+}
+
+/* Read a 32 bit little-endian value. */
+static uint32_t imgr_word(ImgReadCtx *ctx)
+{
+  const uint8_t *p = ctx->p;
+  if (ctx->pe - p < 4) imgr_error(ctx);
+  ctx->p = p + 4;
+  return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+	 ((uint32_t)p[3] << 24);
+}
+
+/* Read ULEB128 value. */
+static uint32_t imgr_uleb128(ImgReadCtx *ctx)
+{
+  const uint8_t *p = ctx->p;
+  uint32_t v = 0;
+  int sh = 0;
+  do {
+    if (p >= ctx->pe || sh > 28) imgr_error(ctx);
+    v |= (uint32_t)(*p & 0x7f) << sh;
+    sh += 7;
+  } while (*p++ >= 0x80);
+  ctx->p = p;
+  return v;
+}
+
+/* Read memory block. */
+static const uint8_t *imgr_mem(ImgReadCtx *ctx, MSize len)
+{
+  const uint8_t *p = ctx->p;
+  if ((MSize)(ctx->pe - p) < len) imgr_error(ctx);
+  ctx->p = p + len;
+  return p;
+}
+
+/* Get an object by its ID. */
+static cTValue *imgr_obj(ImgReadCtx *ctx, uint32_t id)
+{
+  cTValue *o;
+  if (id == 0 || id > ctx->nobj) imgr_error(ctx);
+  o = arrayslot(ctx->objs, id);
+  if (tvisnil(o)) imgr_error(ctx);  /* Not created yet. */
+  return o;
+}
+
+/* Read a value. */
+static void imgr_value(ImgReadCtx *ctx, TValue *o)
+{
+  uint32_t v = imgr_uleb128(ctx);
+  if (v == IMG_V_NIL) {
+    setnilV(o);
+  } else if (v <= IMG_V_TRUE) {
+    setboolV(o, v == IMG_V_TRUE);
+  } else if (v == IMG_V_NUM) {
+    o->u32.lo = imgr_uleb128(ctx);
+    o->u32.hi = imgr_uleb128(ctx);
+    if (!tvisnum(o)) imgr_error(ctx);  /* Must not forge a tagged value. */
+#if LJ_DUALNUM
+    {
+      lua_Number n = o->n;
+      int32_t k = lj_num2int(n);
+      if (n == (lua_Number)k && !tvismzero(o)) setintV(o, k);
+    }
+#endif
+  } else {
+    copyTV(ctx->L, o, imgr_obj(ctx, v - IMG_V_NUM));
+  }
+}
+
+/* Reader callback for bytecode dumps. */
+static const char *imgr_bcreader(lua_State *L, void *ud, size_t *sz)
+{
+  ImgReadCtx *ctx = (ImgReadCtx *)ud;
+  const char *p = (const char *)ctx->p;
+  UNUSED(L);
+  *sz = (size_t)(ctx->pe - ctx->p);
+  ctx->p = ctx->pe;
+  return *sz ? p : NULL;
+}
+
+/* Read a bytecode dump and return the prototype. */
+static GCproto *imgr_proto(ImgReadCtx *ctx, MSize len)
+{
+  lua_State *L = ctx->L;
+  ImgReadCtx bc;
+  int status;
+  bc.p = imgr_mem(ctx, len);
+  bc.pe = bc.p + len;
+  status = lua_loadx(L, imgr_bcreader, &bc, "=image", "b");
+  if (status) lj_err_throw(L, status);
+  L->top--;
+  return funcproto(funcV(L->top));
+}
+
+/* Look up a library object in the loading state. A missing module or
+** table is created and filled from the image later on.
+*/
+static void imgr_ext(ImgReadCtx *ctx, TValue *o, int func)
+{
+  lua_State *L = ctx->L;
+  MSize n = imgr_uleb128(ctx);
+  uint32_t it;
+  GCstr *name = NULL;
+  if (n == 0) imgr_error(ctx);
+  if (!func) setnilV(o);
+  for (; n > 0; n--) {
+    cTValue *parent = imgr_obj(ctx, imgr_uleb128(ctx));
+    TValue key;
+    imgr_value(ctx, &key);
+    if (func) continue;
+    if (!tvistab(parent) || tvisnil(&key)) imgr_error(ctx);
+    if (!name && tvisstr(&key)) name = strV(&key);
+    if (tvisnil(o)) {
+      cTValue *v = lj_tab_get(L, tabV(parent), &key);
+      if (!(tvisfunc(v) && isluafunc(funcV(v))))
+	copyTV(L, o, v);
+    }
+  }
+  it = ~imgr_uleb128(ctx);
+  if (func) return;
+  if (itype(o) != it) {
+    if (tvisnil(o) && it == LJ_TTAB)
+      settabV(L, o, lj_tab_new(L, 0, 0));
+    else
+      lj_err_callerv(L, LJ_ERR_IMGEXT, name ? strdata(name) : "?");
+  }
+}
+
+/* Create the objects from their shells. Lua functions are created last. */
+static void imgr_shells(ImgReadCtx *ctx, int func)
+{
+  lua_State *L = ctx->L;
+  MSize id;
+  for (id = 1; id <= ctx->nobj; id++) {
+    TValue *o = arrayslot(ctx->objs, id);
+    uint32_t type = imgr_uleb128(ctx);
+    switch (type) {
+    case IMG_OBJ_LOADED:
+      if (!func) settabV(L, o, image_loaded(L));
+      break;
+    case IMG_OBJ_EXT:
+      imgr_ext(ctx, o, func);
+      break;
+    case IMG_OBJ_STR: {
+      MSize len = imgr_uleb128(ctx);
+      const char *s = (const char *)imgr_mem(ctx, len);
+      if (!func) setstrV(L, o, lj_str_new(L, s, len));
+      break;
+      }
+    case IMG_OBJ_TAB: {
+      uint32_t asize = imgr_uleb128(ctx), hbits = imgr_uleb128(ctx);
+      if (asize > LJ_MAX_ASIZE || hbits > LJ_MAX_HBITS) imgr_error(ctx);
+      if (!func) settabV(L, o, lj_tab_new(L, asize, hbits));
+      break;
+      }
+    case IMG_OBJ_PROTO: {
+      MSize len = imgr_uleb128(ctx);
+      if (!func) setprotoV(L, o, imgr_proto(ctx, len));
+      else imgr_mem(ctx, len);
+      break;
+      }
+    case IMG_OBJ_FUNC: {
+      uint32_t ptid = imgr_uleb128(ctx);
+      MSize i, nuv = imgr_uleb128(ctx);
+      GCfunc *fn = NULL;
+      if (func) {  /* All prototypes have been created in the first pass. */
+	cTValue *pv = imgr_obj(ctx, ptid);
+	if (!tvisproto(pv) || nuv != protoV(pv)->sizeuv) imgr_error(ctx);
+	fn = lj_func_newL_empty(L, protoV(pv), tabref(L->env));
+	setfuncV(L, o, fn);
+      }
+      for (i = 0; i < nuv; i++) {
+	uint32_t uvid = imgr_uleb128(ctx);
+	TValue *uv;
+	if (!fn) continue;
+	if (uvid == 0 || uvid > ctx->nobj) imgr_error(ctx);
+	uv = arrayslot(ctx->objs, uvid);
+	if (tvisnil(uv)) {  /* First reference: use the new upvalue. */
+	  setgcV(L, uv, gcref(fn->l.uvptr[i]), LJ_TUPVAL);
+	} else if (itype(uv) == LJ_TUPVAL) {  /* Shared upvalue. */
+	  setgcref(fn->l.uvptr[i], gcV(uv));
+	  lj_gc_objbarrier(L, fn, gcV(uv));
+	} else {
+	  imgr_error(ctx);
+	}
+      }
+      break;
+      }
+    case IMG_OBJ_UPVAL:
+      break;
+#if LJ_HASFFI
+    case IMG_OBJ_CDATA: {
+      CTState *cts = ctype_ctsG(G(L));
+      CTypeID ctid = imgr_uleb128(ctx);
+      CTSize sz = imgr_uleb128(ctx);
+      const uint8_t *p = imgr_mem(ctx, sz);
+      if (!func) {
+	GCcdata *cd;
+	CType *ct;
+	if (!cts || ctid >= cts->top) imgr_error(ctx);
+	cts->L = L;
+	ct = ctype_raw(cts, ctid);
+	if (!ctype_hassize(ct->info) || ct->size != sz ||
+	    (ct->info & CTF_VLA) || ctype_align(ct->info) > CT_MEMALIGN)
+	  imgr_error(ctx);
+	cd = lj_cdata_new(cts, ctid, sz);
+	memcpy(cdataptr(cd), p, sz);
+	setcdataV(L, o, cd);
+      }
+      break;
+      }
+#endif
+    default:
+      imgr_error(ctx);
+      break;
+    }
+    lj_gc_anybarriert(L, ctx->objs);
+  }
+}
+
+/* Fill in the references of the objects. */
+static void imgr_fills(ImgReadCtx *ctx)
+{
+  lua_State *L = ctx->L;
+  MSize id;
+  for (id = 1; id <= ctx->nobj; id++) {
+    cTValue *o = arrayslot(ctx->objs, id);
+    TValue v;
+    if (tvistab(o)) {
+      GCtab *t = tabV(o);
+      MSize n;
+      imgr_value(ctx, &v);
+      if (tvistab(&v)) {
+	setgcref(t->metatable, obj2gco(tabV(&v)));
+	lj_gc_objbarriert(L, t, tabV(&v));
+      } else if (!tvisnil(&v)) {
+	imgr_error(ctx);
+      }
+      t->nomm = 0;  /* Invalidate negative metamethod cache. */
+      lj_gc_anybarriert(L, t);  /* Before any error can leave a new value. */
+      for (n = imgr_uleb128(ctx); n > 0; n--) {
+	TValue k;
+	imgr_value(ctx, &k);
+	imgr_value(ctx, &v);
+	copyTV(L, lj_tab_set(L, t, &k), &v);
+      }
+    } else if (tvisfunc(o) && isluafunc(funcV(o))) {
+      GCfunc *fn = funcV(o);
+      imgr_value(ctx, &v);
+      if (!tvistab(&v)) imgr_error(ctx);
+      setgcref(fn->l.env, obj2gco(tabV(&v)));
+      lj_gc_objbarrier(L, fn, tabV(&v));
+    } else if (itype(o) == LJ_TUPVAL) {
+      GCupval *uv = gco2uv(gcV(o));
+      imgr_value(ctx, &v);
+      copyTV(L, uvval(uv), &v);
+      lj_gc_barrier(L, uv, &v);
+    }
+  }
+}
+
+#if LJ_HASFFI
+/* Read the C types added after the predefined ones. */
+static void imgr_ctypes(ImgReadCtx *ctx, MSize nct)
+{
+  lua_State *L = ctx->L;
+  CTState *cts = ctype_ctsG(G(L));
+  CTypeID id, base = lj_ctype_numpredef();
+  if (!cts)
+    lj_err_callerv(L, LJ_ERR_IMGEXT, "ffi");
+  if (cts->top != base)
+    lj_err_caller(L, LJ_ERR_IMGCTYPE);
+  cts->L = L;
+  for (; nct > 0; nct--) {
+    CType *ct;
+    MSize len;
+    uint32_t hashed;
+    id = lj_ctype_new(cts, &ct);
+    ct->info = imgr_uleb128(ctx);
+    ct->size = imgr_uleb128(ctx);
+    ct->sib = (CTypeID1)imgr_uleb128(ctx);
+    hashed = imgr_uleb128(ctx);
+    len = imgr_uleb128(ctx);
+    if (len) {
+      const char *s = (const char *)imgr_mem(ctx, len-1);
+      ctype_setname(ct, lj_str_new(L, s, len-1));
+    }
+    if (hashed) lj_ctype_addhash(cts, ct, id);
+  }
+  for (id = base; id < cts->top; id++) {  /* Check all references. */
+    CType *ct = ctype_get(cts, id);
+    if (ct->sib >= cts->top ||
+	(ctype_type(ct->info) != CT_NUM && ctype_type(ct->info) != CT_VOID &&
+	 ctype_type(ct->info) != CT_STRUCT &&
+	 ctype_cid(ct->info) >= cts->top))
+      imgr_error(ctx);
+  }
+}
+
+/* Read the metatables associated with C types. */
+static void imgr_metatypes(ImgReadCtx *ctx)
+{
+  lua_State *L = ctx->L;
+  CTState *cts = ctype_ctsG(G(L));
+  MSize n = imgr_uleb128(ctx);
+  MSize id;
+  if (n == 0) return;
+  if (!cts) imgr_error(ctx);
+  lj_gc_anybarriert(L, cts->miscmap);
+  for (; n > 0; n--) {
+    CTypeID ctid = imgr_uleb128(ctx);
+    TValue v;
+    imgr_value(ctx, &v);
+    if (ctid >= cts->top || !tvistab(&v)) imgr_error(ctx);
+    copyTV(L, lj_tab_setinth(L, cts->miscmap, -(int32_t)ctid), &v);
+  }
+  for (id = 1; id <= ctx->nobj; id++) {  /* Handle ctype __gc metamethods. */
+    cTValue *o = arrayslot(ctx->objs, id);
+    if (tviscdata(o)) {
+      CTypeID ctid = cdataV(o)->ctypeid;
+      cTValue *tv = lj_tab_getinth(cts->miscmap, -(int32_t)ctid);
+      if (ctype_isstruct(ctype_get(cts, ctid)->info) &&
+	  tv && tvistab(tv) && lj_meta_fast(L, tabV(tv), MM_gc))
+	lj_cdata_setmetafin(L, cdataV(o));
+    }
+  }
+}
+#endif
+
+/* Protected callback for heap image reader. */
+static TValue *cpimageread(lua_State *L, lua_CFunction dummy, void *ud)
+{
+  ImgReadCtx *ctx = (ImgReadCtx *)ud;
+  const uint8_t *shells;
+  uint32_t flags, size, check;
+  MSize nct;
+  UNUSED(dummy);
+  if (ctx->pe - ctx->p < 3 || ctx->p[0] != IMG_HEAD1 ||
+      ctx->p[1] != IMG_HEAD2 || ctx->p[2] != IMG_HEAD3)
+    lj_err_caller(L, LJ_ERR_IMGFMT);
+  ctx->p += 3;
+  flags = imgr_uleb128(ctx);
+  if (flags != IMG_VERSION) lj_err_caller(L, LJ_ERR_IMGFMT);
+  flags = imgr_uleb128(ctx);
+  if (flags != (LJ_BE ? IMG_F_BE : 0) + (LJ_HASFFI ? IMG_F_FFI : 0))
+    lj_err_caller(L, LJ_ERR_IMGFMT);
+  /* Reject truncated or corrupted images before reading any objects. */
+  size = imgr_word(ctx);
+  check = imgr_word(ctx);
+  if ((size_t)(ctx->pe - ctx->p) != size ||
+      image_check(ctx->p, size) != check)
+    imgr_error(ctx);
+  ctx->nobj = imgr_uleb128(ctx);
+  if (ctx->nobj >= LJ_MAX_ASIZE) imgr_error(ctx);
+  ctx->objs = lj_tab_new(L, ctx->nobj+1, 0);
+  settabV(L, L->top, ctx->objs);
+  incr_top(L);
+  nct = imgr_uleb128(ctx);
+#if LJ_HASFFI
+  if (nct) imgr_ctypes(ctx, nct);
+#else
+  if (nct) imgr_error(ctx);
+#endif
+  shells = ctx->p;
+  imgr_shells(ctx, 0);
+  ctx->p = shells;
+  imgr_shells(ctx, 1);
+  imgr_fills(ctx);
+#if LJ_HASFFI
+  imgr_metatypes(ctx);
+#else
+  if (imgr_uleb128(ctx)) imgr_error(ctx);
+#endif
+  if (ctx->p != ctx->pe) imgr_error(ctx);
+  L->top--;
+  return NULL;
+}
+
+/* Read a heap image. */
+int lj_image_read(lua_State *L, const char *buf, size_t size)
+{
+  ImgReadCtx ctx;
+  int status;
+  ctx.L = L;
+  ctx.p = (const uint8_t *)buf;
+  ctx.pe = ctx.p + size;
+  ctx.nobj = 0;
+  status = lj_vm_cpcall(L, NULL, &ctx, cpimageread);
+  lj_gc_check(L);
+  return status;
+}
@@ -0,0 +1,65 @@
+/*
+** Heap image writer and reader.
+** Copyright (C) 2005-2021 Mike Pall. See Copyright Notice in luajit.h
+*/
+
+#ifndef _LJ_IMAGE_H
+#define _LJ_IMAGE_H
+
+#include "lj_obj.h"
+
+/* -- Heap image format --------------------------------------------------- */
+
+/*
+** image  = header numobjU ctypes shell* fill* metatypes
+** header = ESC 'L' 'I' versionB flagsU sizeW checkW
+** ctypes = numctU ctype*   (numctU is 0 without FFI)
+** ctype  = infoU sizeU sibU hashedU (0U | namelen+1U nameB*)
+** shell  = objtypeU { ext | strlenU strB* | asizeU hbitsU |
+**                     dumplenU dumpB* | protoidU numuvU uvidU* |
+**                     ctypeidU sizeU dataB* }
+** ext    = numlocU (parentidU value)* itypeU
+** fill   = value numkvU (value value)*   (tables: metatable, keys/values)
+**        | value                         (Lua functions: env; upvalues)
+** value  = 0U (nil) | 1U (false) | 2U (true) | 3U loU hiU | (3+objid)U
+** metatypes = numU (ctypeidU value)*
+**
+** Objects are numbered from 1 in the order of the shells. Fills follow in
+** the same order for all tables, Lua functions and upvalues. The size and
+** the FNV-1a hash of the data after the header are checked before reading
+** anything else.
+**
+** B = 8 bit, U = ULEB128 of 32 bit, W = 32 bit little-endian
+*/
+
+/* Heap image header. */
+#define IMG_HEAD1		0x1b
+#define IMG_HEAD2		0x4c
+#define IMG_HEAD3		0x49
+
+/* Images are only compatible with the same LuaJIT build. */
+#define IMG_VERSION		2
+
+/* Compatibility flags. */
+#define IMG_F_BE		0x01
+#define IMG_F_FFI		0x02
+
+/* Object types of shells. */
+enum {
+  IMG_OBJ_LOADED,	/* The package.loaded table, i.e. the root object. */
+  IMG_OBJ_EXT,		/* Library object, looked up in the loading state. */
+  IMG_OBJ_STR, IMG_OBJ_TAB, IMG_OBJ_PROTO, IMG_OBJ_FUNC, IMG_OBJ_UPVAL,
+  IMG_OBJ_CDATA
+};
+
+/* Type codes for values. Object references follow. */
+enum {
+  IMG_V_NIL, IMG_V_FALSE, IMG_V_TRUE, IMG_V_NUM
+};
+
+/* -- Heap image writer/reader -------------------------------------------- */
+
+LJ_FUNC int lj_image_write(lua_State *L, lua_Writer writer, void *data);
+LJ_FUNC int lj_image_read(lua_State *L, const char *buf, size_t size);
+
+#endif
@@ -25,6 +25,7 @@
 #if LJ_HASFFI
 #include "lj_ctype.h"
 #include "lj_cdata.h"
+#include "lj_cconv.h"
 #include "lj_carith.h"
 #endif
 #include "lj_vm.h"
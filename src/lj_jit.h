@@ -71,18 +71,20 @@
 #define JIT_F_OPT_ABC		0x00800000
 #define JIT_F_OPT_SINK		0x01000000
 #define JIT_F_OPT_FUSE		0x02000000
+#define JIT_F_OPT_WATCH		0x04000000
 
 /* Optimizations names for -O. Must match the order above. */
 #define JIT_F_OPT_FIRST		JIT_F_OPT_FOLD
 #define JIT_F_OPTSTRING	\
-  "\4fold\3cse\3dce\3fwd\3dse\6narrow\4loop\3abc\4sink\4fuse"
+  "\4fold\3cse\3dce\3fwd\3dse\6narrow\4loop\3abc\4sink\4fuse\5watch"
 
 /* Optimization levels set a fixed combination of flags. */
 #define JIT_F_OPT_0	0
 #define JIT_F_OPT_1	(JIT_F_OPT_FOLD|JIT_F_OPT_CSE|JIT_F_OPT_DCE)
 #define JIT_F_OPT_2	(JIT_F_OPT_1|JIT_F_OPT_NARROW|JIT_F_OPT_LOOP)
 #define JIT_F_OPT_3	(JIT_F_OPT_2|\
-  JIT_F_OPT_FWD|JIT_F_OPT_DSE|JIT_F_OPT_ABC|JIT_F_OPT_SINK|JIT_F_OPT_FUSE)
+  JIT_F_OPT_FWD|JIT_F_OPT_DSE|JIT_F_OPT_ABC|JIT_F_OPT_SINK|JIT_F_OPT_FUSE|\
+  JIT_F_OPT_WATCH)
 #define JIT_F_OPT_DEFAULT	JIT_F_OPT_3
 
 #if LJ_TARGET_WINDOWS || LJ_64
@@ -110,6 +112,8 @@
   _(\012, callunroll,	3)	/* Max. unroll for recursive calls. */ \
   _(\011, recunroll,	2)	/* Min. unroll for true recursion. */ \
   \
+  _(\010, cooldown,	0)	/* # of GC cycles to retry blacklisted code. */ \
+  \
   /* Size of each machine code area (in KBytes). */ \
   _(\011, sizemcode,	JIT_P_sizemcode_DEFAULT) \
   /* Max. total size of all machine code areas (in KBytes). */ \
@@ -180,6 +184,7 @@ typedef uint32_t SnapEntry;
 #define SNAP_CONT		0x020000	/* Continuation slot. */
 #define SNAP_NORESTORE		0x040000	/* No need to restore slot. */
 #define SNAP_SOFTFPNUM		0x080000	/* Soft-float number. */
+#define SNAP_KEYREF		0x100000	/* Packed: prefix of key snapshot. */
 LJ_STATIC_ASSERT(SNAP_FRAME == TREF_FRAME);
 LJ_STATIC_ASSERT(SNAP_CONT == TREF_CONT);
 
@@ -194,6 +199,11 @@ LJ_STATIC_ASSERT(SNAP_CONT == TREF_CONT);
 #define snap_pc(sn)		((const BCIns *)(uintptr_t)(sn))
 #define snap_setref(sn, ref)	(((sn) & (0xffff0000&~SNAP_NORESTORE)) | (ref))
 
+/* Min. length of a shared prefix in a packed snapshot map. */
+#define SNAP_MINPREFIX		3
+/* Max. size of an unpacked snapshot map, i.e. entries plus the PC. */
+#define SNAP_MAXMAP		256
+
 /* Snapshot and exit numbers. */
 typedef uint32_t SnapNo;
 typedef uint32_t ExitNo;
@@ -273,6 +283,38 @@ typedef struct HotPenalty {
 #define PENALTY_MAX	60000	/* Maximum penalty value. */
 #define PENALTY_RNDBITS	4	/* # of random bits to add to penalty value. */
 
+/* Round-robin cache of inlined calls which ran out of IR in a trace. */
+typedef struct HotCallout {
+  MRef startpc;		/* Starting bytecode PC of the trace. */
+  MRef pc;		/* Bytecode PC of the function entry to stop at. */
+} HotCallout;
+
+#define CALLOUT_SLOTS	16	/* Callout cache slots. Must be a power of 2. */
+
+/* Round-robin cache of blacklisted bytecodes, retried after a cooldown. */
+typedef struct HotBlacklist {
+  GCRef pt;		/* Prototype holding the bytecode or NULL. */
+  BCPos pos;		/* Position of the blacklisted bytecode. */
+  uint16_t wait;	/* GC cycles until the next retry or 0 if retried. */
+  uint16_t retry;	/* Number of retries so far. */
+} HotBlacklist;
+
+#define BLACKLIST_SLOTS	32	/* Blacklist slots. Must be a power of 2. */
+#define BLACKLIST_RETRY	3	/* Max. # of retries before giving up. */
+
+/* Table slot watched by traces. Neither the table nor the key are marked,
+** they are only compared. Flushing all traces clears the watch slots.
+*/
+typedef struct WatchSlot {
+  GCRef tab;		/* Table or NULL for the key of any table (store only). */
+  GCRef key;		/* String key. */
+  uint32_t store;	/* 0: treated as a constant, 1: stored to by a trace. */
+} WatchSlot;
+
+#define WATCH_SLOTS	256	/* Max. number of watched table slots. */
+
+#define RPTR_MAX	4	/* Max. restrict-qualified pointer objects. */
+
 /* Round-robin backpropagation cache for narrowing conversions. */
 typedef struct BPropEntry {
   IRRef1 key;		/* Key: original reference. */
@@ -384,8 +426,20 @@ typedef struct jit_State {
 
   HotPenalty penalty[PENALTY_SLOTS];  /* Penalty slots. */
   uint32_t penaltyslot;	/* Round-robin index into penalty slots. */
+  HotCallout callout[CALLOUT_SLOTS];  /* Callout slots. */
+  uint32_t calloutslot;	/* Round-robin index into callout slots. */
+  HotBlacklist blacklist[BLACKLIST_SLOTS];  /* Blacklist slots. */
+  uint32_t blacklistslot;  /* Round-robin index into blacklist slots. */
   uint32_t prngstate;	/* PRNG state. */
 
+  WatchSlot watch[WATCH_SLOTS];  /* Watched table slots. */
+  MSize nwatch;		/* Number of used watch slots. */
+  MSize watchmark;	/* Number of watch slots at the start of the trace. */
+
+  IRRef1 rptr[RPTR_MAX];  /* cdata.rptr loads of the current trace. */
+  GCRef rptrcd[RPTR_MAX];  /* Their cdata objects while recording. */
+  MSize nrptr;		/* Number of cdata.rptr loads. */
+
   BPropEntry bpropcache[BPROP_SLOTS];  /* Backpropagation cache slots. */
   uint32_t bpropslot;	/* Round-robin index into bpropcache slots. */
 
@@ -106,7 +106,16 @@ LJ_FUNC void lj_lib_register(lua_State *L, const char *libname,
 
 /* Exported library functions. */
 
-typedef struct RandomState RandomState;
+/* PRNG state of math.random. */
+typedef struct RandomState {
+  uint64_t gen[4];	/* State of the 4 LFSR generators. */
+  int valid;		/* State is valid. */
+} RandomState;
+
+/* Parameters (i, k, q, s) of the 4 LFSR generators. */
+#define RANDOM_GENDEF(_) \
+  _(0, 63, 31, 18) _(1, 58, 19, 28) _(2, 55, 24,  7) _(3, 47, 21,  8)
+
 LJ_FUNC uint64_t LJ_FASTCALL lj_math_random_step(RandomState *rs);
 
 #endif
@@ -11,6 +11,7 @@
 
 #include "lua.h"
 #include "lauxlib.h"
+#include "luajit.h"
 
 #include "lj_obj.h"
 #include "lj_gc.h"
@@ -22,6 +23,7 @@
 #include "lj_lex.h"
 #include "lj_bcdump.h"
 #include "lj_parse.h"
+#include "lj_image.h"
 
 /* -- Load Lua source code and bytecode ----------------------------------- */
 
@@ -166,3 +168,14 @@ LUA_API int lua_dump(lua_State *L, lua_Writer writer, void *data)
     return 1;
 }
 
+/* -- Heap images --------------------------------------------------------- */
+
+LUA_API int luaJIT_dumpimage(lua_State *L, lua_Writer writer, void *data)
+{
+  return lj_image_write(L, writer, data);
+}
+
+LUA_API int luaJIT_loadimage(lua_State *L, const char *buf, size_t size)
+{
+  return lj_image_read(L, buf, size);
+}
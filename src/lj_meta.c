@@ -19,6 +19,7 @@
 #include "lj_bc.h"
 #include "lj_vm.h"
 #include "lj_strscan.h"
+#include "lj_trace.h"
 
 /* -- Metamethod handling ------------------------------------------------- */
 
@@ -40,10 +41,21 @@ void lj_meta_init(lua_State *L)
   }
 }
 
+/* Inlined lookup of an interned string key in the hash part. */
+static LJ_AINLINE cTValue *meta_getstr(GCtab *t, GCstr *key)
+{
+  Node *n = &noderef(t->node)[key->hash & t->hmask];
+  do {
+    if (tvisstr(&n->key) && strV(&n->key) == key)
+      return &n->val;
+  } while ((n = nextnode(n)));
+  return NULL;
+}
+
 /* Negative caching of a few fast metamethods. See the lj_meta_fast() macro. */
 cTValue *lj_meta_cache(GCtab *mt, MMS mm, GCstr *name)
 {
-  cTValue *mo = lj_tab_getstr(mt, name);
+  cTValue *mo = meta_getstr(mt, name);
   lua_assert(mm <= MM_FAST);
   if (!mo || tvisnil(mo)) {  /* No metamethod? */
     mt->nomm |= (uint8_t)(1u<<mm);  /* Set negative cache flag. */
@@ -129,11 +141,24 @@ cTValue *lj_meta_tget(lua_State *L, cTValue *o, cTValue *k)
   for (loop = 0; loop < LJ_MAX_IDXCHAIN; loop++) {
     cTValue *mo;
     if (LJ_LIKELY(tvistab(o))) {
-      GCtab *t = tabV(o);
-      cTValue *tv = lj_tab_get(L, t, k);
-      if (!tvisnil(tv) ||
-	  !(mo = lj_meta_fast(L, tabref(t->metatable), MM_index)))
+      GCtab *t = tabV(o), *mt;
+      cTValue *tv;
+      if (tvisstr(k)) {  /* Inline the common case of method/field lookups. */
+	tv = meta_getstr(t, strV(k));
+	if (!tv) tv = niltv(L);
+      } else {
+	tv = lj_tab_get(L, t, k);
+      }
+      if (!tvisnil(tv))
 	return tv;
+      mt = tabref(t->metatable);
+      if (!mt || (mt->nomm & (1u<<MM_index)))
+	return tv;
+      mo = meta_getstr(mt, mmname_str(G(L), MM_index));
+      if (!mo || tvisnil(mo)) {
+	mt->nomm |= (uint8_t)(1u<<MM_index);  /* Set negative cache flag. */
+	return tv;
+      }
     } else if (tvisnil(mo = lj_meta_lookup(L, o, MM_index))) {
       lj_err_optype(L, o, LJ_ERR_OPINDEX);
       return NULL;  /* unreachable */
@@ -159,6 +184,8 @@ TValue *lj_meta_tset(lua_State *L, cTValue *o, cTValue *k)
       GCtab *t = tabV(o);
       cTValue *tv = lj_tab_get(L, t, k);
       if (LJ_LIKELY(!tvisnil(tv))) {
+	if (LJ_UNLIKELY(t->colo & LJ_COLO_WATCH) && tvisstr(k))
+	  lj_trace_watchset(L, t, strV(k));
 	t->nomm = 0;  /* Invalidate negative metamethod cache. */
 	lj_gc_anybarriert(L, t);
 	return (TValue *)tv;
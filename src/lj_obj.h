@@ -410,7 +410,7 @@ LJ_STATIC_ASSERT(offsetof(Node, val) == 0);
 typedef struct GCtab {
   GCHeader;
   uint8_t nomm;		/* Negative cache for fast metamethods. */
-  int8_t colo;		/* Array colocation. */
+  int8_t colo;		/* Array colocation and LJ_COLO_* flags. */
   MRef array;		/* Array part. */
   GCRef gclist;
   GCRef metatable;	/* Must be at same offset in GCudata. */
@@ -420,6 +420,12 @@ typedef struct GCtab {
 } GCtab;
 
 #define sizetabcolo(n)	((n)*sizeof(TValue) + sizeof(GCtab))
+
+/* Flags in the unused bits of colo. Colocated arrays are small. */
+#define LJ_COLO_WATCH	0x40	/* Traces treat some slots as constants. */
+#define LJ_COLO_NOWATCH	0x20	/* Never watch slots of this table. */
+#define LJ_COLO_FLAGS	(LJ_COLO_WATCH|LJ_COLO_NOWATCH)
+#define tabcolo(t)	((int8_t)((t)->colo & ~LJ_COLO_FLAGS))
 #define tabref(r)	(&gcref((r))->tab)
 #define noderef(r)	(mref((r), Node))
 #define nextnode(n)	(mref((n)->next, Node))
@@ -494,7 +500,7 @@ typedef struct GCState {
   uint8_t currentwhite;	/* Current white color. */
   uint8_t state;	/* GC state. */
   uint8_t nocdatafin;	/* No cdata finalizer called. */
-  uint8_t unused2;
+  uint8_t frozen;	/* Frozen heap state. */
   MSize sweepstr;	/* Sweep position in string table. */
   GCRef root;		/* List of all collectable objects. */
   MRef sweep;		/* Sweep position in root list. */
@@ -502,6 +508,10 @@ typedef struct GCState {
   GCRef grayagain;	/* List of objects for atomic traversal. */
   GCRef weak;		/* List of weak tables (to be cleared). */
   GCRef mmudata;	/* List of userdata (to be finalized). */
+  GCRef froot;		/* List of frozen objects. */
+  MRef rem;		/* Remembered set of frozen objects. */
+  MSize remnum;		/* Number of remembered objects. */
+  MSize remsize;	/* Size of remembered set. */
   MSize stepmul;	/* Incremental GC step granularity. */
   MSize debt;		/* Debt (how much GC is behind schedule). */
   MSize estimate;	/* Estimate of memory actually in use. */
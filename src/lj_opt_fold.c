@@ -1259,12 +1259,25 @@ LJFOLDF(simplify_intmod_kleft)
   return NEXTFOLD;
 }
 
+/* Drop overflow check, if the ranges of the operands rule out an overflow. */
+static int fold_intov_range(jit_State *J)
+{
+  if (lj_opt_narrow_noov(J, fins)) {
+    fins->o = (IROp1)(fins->o - IR_ADDOV + IR_ADD);
+    fins->t.irt = IRT_INT;  /* Also clears the guard flag. */
+    return 1;
+  }
+  return 0;
+}
+
 LJFOLD(SUB any any)
 LJFOLD(SUBOV any any)
 LJFOLDF(simplify_intsub)
 {
   if (fins->op1 == fins->op2 && !irt_isnum(fins->t))  /* i - i ==> 0 */
     return irt_is64(fins->t) ? INT64FOLD(0) : INTFOLD(0);
+  if (fins->o == IR_SUBOV && fold_intov_range(J))
+    return RETRYFOLD;
   return NEXTFOLD;
 }
 
@@ -1724,8 +1737,6 @@ LJFOLDF(abc_invar)
 
 LJFOLD(ADD any any)
 LJFOLD(MUL any any)
-LJFOLD(ADDOV any any)
-LJFOLD(MULOV any any)
 LJFOLDF(comm_swap)
 {
   if (fins->op1 < fins->op2) {  /* Move lower ref to the right. */
@@ -1737,6 +1748,15 @@ LJFOLDF(comm_swap)
   return NEXTFOLD;
 }
 
+LJFOLD(ADDOV any any)
+LJFOLD(MULOV any any)
+LJFOLDF(comm_swapov)
+{
+  if (fold_intov_range(J))
+    return RETRYFOLD;
+  return fold_comm_swap(J);
+}
+
 LJFOLD(EQ any any)
 LJFOLD(NE any any)
 LJFOLDF(comm_equal)
@@ -1760,6 +1780,18 @@ LJFOLDF(comm_comp)
   /* For non-numbers only: x <=> x ==> drop; x <> x ==> fail */
   if (fins->op1 == fins->op2 && !irt_isnum(fins->t))
     return CONDFOLD((fins->o ^ (fins->o >> 1)) & 1);
+  if (irt_isint(fins->t) && fins->o <= IR_GT) {
+    /* Drop signed comparison, if it holds for the whole operand ranges. */
+    int32_t alo, ahi, blo, bhi;
+    lj_opt_narrow_range(J, fins->op1, &alo, &ahi);
+    lj_opt_narrow_range(J, fins->op2, &blo, &bhi);
+    switch ((IROp)fins->o) {
+    case IR_LT: if (ahi < blo) return DROPFOLD; break;
+    case IR_GE: if (alo >= bhi) return DROPFOLD; break;
+    case IR_LE: if (ahi <= blo) return DROPFOLD; break;
+    default: if (alo > bhi) return DROPFOLD; break;
+    }
+  }
   if (fins->op1 < fins->op2) {  /* Move lower ref to the right. */
     IRRef1 tmp = fins->op1;
     fins->op1 = fins->op2;
@@ -2027,6 +2059,7 @@ LJFOLDF(fload_cdata_typeid_kgc)
 
 /* Get the contents of immutable cdata objects. */
 LJFOLD(FLOAD KGC IRFL_CDATA_PTR)
+LJFOLD(FLOAD KGC IRFL_CDATA_RPTR)
 LJFOLD(FLOAD KGC IRFL_CDATA_INT)
 LJFOLD(FLOAD KGC IRFL_CDATA_INT64)
 LJFOLDF(fload_cdata_int64_kgc)
@@ -2052,6 +2085,7 @@ LJFOLDF(fload_cdata_typeid_cnew)
 
 /* Pointer, int and int64 cdata objects are immutable. */
 LJFOLD(FLOAD CNEWI IRFL_CDATA_PTR)
+LJFOLD(FLOAD CNEWI IRFL_CDATA_RPTR)
 LJFOLD(FLOAD CNEWI IRFL_CDATA_INT)
 LJFOLD(FLOAD CNEWI IRFL_CDATA_INT64)
 LJFOLDF(fload_cdata_ptr_int64_cnew)
@@ -2064,6 +2098,7 @@ LJFOLDF(fload_cdata_ptr_int64_cnew)
 LJFOLD(FLOAD any IRFL_STR_LEN)
 LJFOLD(FLOAD any IRFL_CDATA_CTYPEID)
 LJFOLD(FLOAD any IRFL_CDATA_PTR)
+LJFOLD(FLOAD any IRFL_CDATA_RPTR)
 LJFOLD(FLOAD any IRFL_CDATA_INT)
 LJFOLD(FLOAD any IRFL_CDATA_INT64)
 LJFOLD(VLOAD any any)  /* Vararg loads have no corresponding stores. */
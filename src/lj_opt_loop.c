@@ -415,8 +415,13 @@ int lj_opt_loop(jit_State *J)
       case LJ_TRERR_TYPEINS:  /* Type instability. */
       case LJ_TRERR_GFAIL:  /* Guard would always fail. */
 	/* Unrolling via recording fixes many cases, e.g. a flipped boolean. */
-	if (--J->instunroll < 0)  /* But do not unroll forever. */
+	if (--J->instunroll < 0 &&  /* But do not unroll forever. */
+	    (J->parent || J->cur.linktype != LJ_TRLINK_LOOP))
 	  break;
+	/* Otherwise record one more iteration of the root trace and let it
+	** link to its own entry. The type checks at the entry then dispatch
+	** to side traces for the other types. See rec_loop_interp().
+	*/
 	L->top--;  /* Remove error object. */
 	loop_undo(J, nins, nsnap, nsnapmap);
 	return 1;  /* Loop optimization failed, continue recording. */
@@ -486,7 +486,7 @@ static AliasRet aa_fref(jit_State *J, IRIns *refa, IRIns *refb)
     return ALIAS_NO;  /* Different fields. */
   if (refa->op1 == refb->op1)
     return ALIAS_MUST;  /* Same field, same object. */
-  else if (refa->op2 >= IRFL_TAB_META && refa->op2 <= IRFL_TAB_NOMM)
+  else if (refa->op2 >= IRFL_TAB_META && refa->op2 <= IRFL_TAB_COLO)
     return aa_table(J, refa->op1, refb->op1);  /* Disambiguate tables. */
   else
     return ALIAS_MAY;  /* Same field, possibly different object. */
@@ -593,6 +593,17 @@ static AliasRet aa_cnew(jit_State *J, IRIns *refa, IRIns *refb)
   return aa_escape(J, cnewa, refb);
 }
 
+/* Get the restrict-qualified cdata pointer a reference is derived from. */
+static IRIns *aa_restrict(jit_State *J, IRIns *ir)
+{
+  while (ir->o == IR_ADD) {  /* Skip index and offset arithmetic. */
+    IRIns *ir1 = IR(ir->op1);
+    ir = (irt_type(ir1->t) == IRT_P32 || irt_type(ir1->t) == IRT_P64) ? ir1 :
+	 IR(ir->op2);
+  }
+  return (ir->o == IR_FLOAD && ir->op2 == IRFL_CDATA_RPTR) ? ir : NULL;
+}
+
 /* Alias analysis for XLOAD/XSTORE. */
 static AliasRet aa_xref(jit_State *J, IRIns *refa, IRIns *xa, IRIns *xb)
 {
@@ -634,6 +645,19 @@ static AliasRet aa_xref(jit_State *J, IRIns *refa, IRIns *xa, IRIns *xb)
     /* NYI: extract, extend or reinterpret bits (int <-> fp). */
     return ALIAS_MAY;  /* Overlapping or type punning: force reload. */
   }
+  /* Restrict-qualified pointers only alias pointers derived from them.
+  ** The recorder guards different cdata.rptr loads to belong to different
+  ** objects. But a load before the LOOP and its copy after it may get the
+  ** same object in different iterations.
+  */
+  {
+    IRIns *ra = aa_restrict(J, basea), *rb = aa_restrict(J, baseb);
+    IRRef loop = J->chain[IR_LOOP];
+    if (ra != rb && (!loop || !ra || !rb ||
+		     ((IRRef)(ra - J->cur.ir) > loop) ==
+		     ((IRRef)(rb - J->cur.ir) > loop)))
+      return ALIAS_NO;
+  }
   if (!irt_sametype(xa->t, xb->t) &&
       !(irt_typerange(xa->t, IRT_I8, IRT_U64) &&
 	((xa->t.irt - IRT_I8) ^ (xb->t.irt - IRT_I8)) == 1))
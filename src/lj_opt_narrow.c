@@ -617,6 +617,156 @@ split_pow:
   return emitir(IRTN(IR_FPMATH), rc, IRFPM_EXP2);
 }
 
+/* -- Integer value ranges ------------------------------------------------ */
+
+/* Maximum depth for the range derivation of an expression. */
+#define NARROW_MAX_RANGE	6
+
+static void narrow_range(jit_State *J, IRRef ref, int64_t *lo, int64_t *hi,
+			 int depth);
+
+/* Derive the unbounded range of an integer ADD, SUB or MUL (or xxxOV). */
+static void narrow_range_arith(jit_State *J, IRIns *ir, int64_t *lo,
+			       int64_t *hi, int depth)
+{
+  int64_t alo, ahi, blo, bhi;
+  narrow_range(J, ir->op1, &alo, &ahi, depth);
+  narrow_range(J, ir->op2, &blo, &bhi, depth);
+  switch (ir->o) {
+  case IR_ADD: case IR_ADDOV:
+    *lo = alo + blo; *hi = ahi + bhi;
+    break;
+  case IR_SUB: case IR_SUBOV:
+    *lo = alo - bhi; *hi = ahi - blo;
+    break;
+  default: {
+    int64_t p1 = alo*blo, p2 = alo*bhi, p3 = ahi*blo, p4 = ahi*bhi;
+    *lo = p1 < p2 ? p1 : p2; if (p3 < *lo) *lo = p3; if (p4 < *lo) *lo = p4;
+    *hi = p1 > p2 ? p1 : p2; if (p3 > *hi) *hi = p3; if (p4 > *hi) *hi = p4;
+    break;
+    }
+  }
+}
+
+/* Derive a conservative range for an integer reference.
+**
+** The range only depends on the shape of the expression and on facts which
+** hold for every iteration: constants, the checked FORL index and the
+** limits of loaded types. So it's valid for the pre-roll and for the copied
+** instructions of the loop body alike. Loop-carried values (PHIs) are not
+** tracked, they simply get the full range of their type.
+*/
+static void narrow_range(jit_State *J, IRRef ref, int64_t *lo, int64_t *hi,
+			 int depth)
+{
+  IRIns *ir = IR(ref);
+  int64_t alo, ahi, blo, bhi;
+  *lo = INT32_MIN; *hi = INT32_MAX;
+  if (ir->o == IR_KINT) {
+    *lo = *hi = ir->i;
+    return;
+  }
+  if (!irt_isint(ir->t) || --depth < 0)
+    return;
+  if (ref == J->scev.idx) {  /* FORL index is checked against start/stop. */
+    IRRef start = J->scev.start, stop = J->scev.stop;
+    lua_assert(irt_isint(J->scev.t));
+    if (start && IR(start)->o == IR_KINT) {
+      if (J->scev.dir) *lo = IR(start)->i; else *hi = IR(start)->i;
+    }
+    if (IR(stop)->o == IR_KINT) {
+      if (J->scev.dir) *hi = IR(stop)->i; else *lo = IR(stop)->i;
+    }
+    return;
+  }
+  switch (ir->o) {
+  case IR_ADD: case IR_ADDOV: case IR_SUB: case IR_SUBOV:
+  case IR_MUL: case IR_MULOV: {
+    int64_t l, h;
+    narrow_range_arith(J, ir, &l, &h, depth);
+    if (ir->o >= IR_ADDOV) {  /* Results outside of int32 leave the trace. */
+      if (l <= INT32_MAX && h >= INT32_MIN) {
+	if (l > INT32_MIN) *lo = l;
+	if (h < INT32_MAX) *hi = h;
+      }
+    } else if (l >= INT32_MIN && h <= INT32_MAX) {  /* No wrap-around? */
+      *lo = l; *hi = h;
+    }
+    break;
+    }
+  case IR_NEG:
+    narrow_range(J, ir->op1, &alo, &ahi, depth);
+    if (alo > INT32_MIN) { *lo = -ahi; *hi = -alo; }
+    break;
+  case IR_MOD:  /* Result has the sign of the divisor. */
+    narrow_range(J, ir->op2, &blo, &bhi, depth);
+    if (blo > 0) { *lo = 0; *hi = bhi-1; }
+    break;
+  case IR_MIN: case IR_MAX:
+    narrow_range(J, ir->op1, &alo, &ahi, depth);
+    narrow_range(J, ir->op2, &blo, &bhi, depth);
+    if (ir->o == IR_MIN) {
+      *lo = alo < blo ? alo : blo; *hi = ahi < bhi ? ahi : bhi;
+    } else {
+      *lo = alo > blo ? alo : blo; *hi = ahi > bhi ? ahi : bhi;
+    }
+    break;
+  case IR_BAND:
+    narrow_range(J, ir->op1, &alo, &ahi, depth);
+    narrow_range(J, ir->op2, &blo, &bhi, depth);
+    if (alo >= 0 || blo >= 0) {  /* Bounded by any non-negative operand. */
+      *lo = 0;
+      *hi = alo >= 0 && (blo < 0 || ahi < bhi) ? ahi : bhi;
+    }
+    break;
+  case IR_BSHR: case IR_BSAR:
+    if (irref_isk(ir->op2)) {
+      int32_t sh = (IR(ir->op2)->i & 31);
+      narrow_range(J, ir->op1, &alo, &ahi, depth);
+      if (ir->o == IR_BSAR || alo >= 0) {
+	*lo = alo >> sh; *hi = ahi >> sh;
+      } else if (sh) {
+	*lo = 0; *hi = (int64_t)(0xffffffffu >> sh);
+      }
+    }
+    break;
+  case IR_CONV:
+    switch ((ir->op2 & IRCONV_SRCMASK)) {
+    case IRT_I8: *lo = -128; *hi = 127; break;
+    case IRT_U8: *lo = 0; *hi = 255; break;
+    case IRT_I16: *lo = -32768; *hi = 32767; break;
+    case IRT_U16: *lo = 0; *hi = 65535; break;
+    default: break;
+    }
+    break;
+  case IR_FLOAD:
+    if (ir->op2 == IRFL_STR_LEN) {
+      *lo = 0; *hi = LJ_MAX_STR;
+    } else if (ir->op2 == IRFL_TAB_ASIZE) {
+      *lo = 0; *hi = LJ_MAX_ASIZE;
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+/* Get the range of an integer reference. */
+void lj_opt_narrow_range(jit_State *J, IRRef ref, int32_t *lo, int32_t *hi)
+{
+  int64_t l, h;
+  narrow_range(J, ref, &l, &h, NARROW_MAX_RANGE);
+  *lo = (int32_t)l; *hi = (int32_t)h;
+}
+
+/* Check whether the overflow check of an ADDOV, SUBOV or MULOV is redundant. */
+int lj_opt_narrow_noov(jit_State *J, IRIns *ir)
+{
+  int64_t l, h;
+  narrow_range_arith(J, ir, &l, &h, NARROW_MAX_RANGE);
+  return l >= INT32_MIN && h <= INT32_MAX;
+}
+
 /* -- Predictive narrowing of induction variables ------------------------- */
 
 /* Narrow a single runtime value. */
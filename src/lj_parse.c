@@ -403,6 +403,17 @@ static void expr_free(FuncState *fs, ExpDesc *e)
 
 /* -- Bytecode emitter ---------------------------------------------------- */
 
+/* Grow bytecode stack. */
+static void bcemit_grow(FuncState *fs)
+{
+  LexState *ls = fs->ls;
+  ptrdiff_t base = fs->bcbase - ls->bcstack;
+  checklimit(fs, ls->sizebcstack, LJ_MAX_BCINS, "bytecode instructions");
+  lj_mem_growvec(fs->L, ls->bcstack, ls->sizebcstack, LJ_MAX_BCINS,BCInsLine);
+  fs->bclim = (BCPos)(ls->sizebcstack - base);
+  fs->bcbase = ls->bcstack + base;
+}
+
 /* Emit bytecode instruction. */
 static BCPos bcemit_INS(FuncState *fs, BCIns ins)
 {
@@ -410,19 +421,49 @@ static BCPos bcemit_INS(FuncState *fs, BCIns ins)
   LexState *ls = fs->ls;
   jmp_patchval(fs, fs->jpc, pc, NO_REG, pc);
   fs->jpc = NO_JMP;
-  if (LJ_UNLIKELY(pc >= fs->bclim)) {
-    ptrdiff_t base = fs->bcbase - ls->bcstack;
-    checklimit(fs, ls->sizebcstack, LJ_MAX_BCINS, "bytecode instructions");
-    lj_mem_growvec(fs->L, ls->bcstack, ls->sizebcstack, LJ_MAX_BCINS,BCInsLine);
-    fs->bclim = (BCPos)(ls->sizebcstack - base);
-    fs->bcbase = ls->bcstack + base;
-  }
+  if (LJ_UNLIKELY(pc >= fs->bclim))
+    bcemit_grow(fs);
   fs->bcbase[pc].ins = ins;
   fs->bcbase[pc].line = ls->lastline;
   fs->pc = pc+1;
   return pc;
 }
 
+/* Insert bytecode instruction before an already emitted one at pc.
+** All jumps, jump lists and positions of variables, gotos and labels are
+** relocated. Positions pointing to pc now point to the new instruction.
+*/
+static void bcemit_insert(FuncState *fs, BCPos pc, BCIns ins)
+{
+  LexState *ls = fs->ls;
+  BCInsLine *base;
+  VarInfo *v, *ve;
+  BCPos i;
+  lua_assert(pc < fs->pc && bcmode_d(bc_op(fs->bcbase[pc].ins)) != BCMjump);
+  if (LJ_UNLIKELY(fs->pc >= fs->bclim))
+    bcemit_grow(fs);
+  base = fs->bcbase;
+  memmove(base+pc+1, base+pc, (fs->pc-pc)*sizeof(BCInsLine));
+  base[pc].ins = ins;  /* Keeps the line of the shifted instruction. */
+  fs->pc++;
+  for (i = 0; i < fs->pc; i++) {
+    BCIns *ip = &base[i].ins;
+    if (i != pc && bcmode_d(bc_op(*ip)) == BCMjump) {
+      BCPos src = i > pc ? i-1 : i;
+      BCPos dest = (BCPos)((ptrdiff_t)src+1+bc_j(*ip));  /* NO_JMP: src. */
+      if (dest > pc) dest++;
+      setbc_j(ip, (ptrdiff_t)dest-(ptrdiff_t)(i+1));
+    }
+  }
+  if (fs->lasttarget > pc) fs->lasttarget++;
+  if (fs->jpc != NO_JMP && fs->jpc >= pc) fs->jpc++;
+  for (v = ls->vstack + fs->vbase, ve = ls->vstack + ls->vtop; v < ve; v++)
+    if (v->startpc > pc) {  /* Variables starting after pc are dead by now. */
+      v->startpc++;
+      if (!(v->info & (VSTACK_GOTO|VSTACK_LABEL))) v->endpc++;
+    }
+}
+
 #define bcemit_ABC(fs, o, a, b, c)	bcemit_INS(fs, BCINS_ABC(o, a, b, c))
 #define bcemit_AD(fs, o, a, d)		bcemit_INS(fs, BCINS_AD(o, a, d))
 #define bcemit_AJ(fs, o, a, j)		bcemit_INS(fs, BCINS_AJ(o, a, j))
@@ -2424,6 +2465,114 @@ static void parse_label(LexState *ls)
   gola_resolve(ls, fs->bl, idx);
 }
 
+/* -- Multi-way branches -------------------------------------------------- */
+
+/* Minimum number of cases for a multi-way branch. */
+#define SWITCH_MINCASE		6
+
+/* Check for a case test 'local == string/number' of an if/elseif chain. */
+static int switch_iscase(FuncState *fs, BCPos pc, BCPos jmp, BCReg *slot)
+{
+  BCIns ins;
+  if (jmp != pc+1 || jmp_next(fs, jmp) != NO_JMP)
+    return 0;  /* More than a single comparison. */
+  ins = fs->bcbase[pc].ins;
+  if (!(bc_op(ins) == BC_ISNES || bc_op(ins) == BC_ISNEN) ||
+      bc_a(ins) >= fs->nactvar)
+    return 0;
+  if (*slot == NO_REG) *slot = bc_a(ins);
+  return bc_a(ins) == *slot;
+}
+
+/* Get the constant key of a case test. Slow, but only done once per case. */
+static void switch_key(FuncState *fs, BCIns ins, TValue *o)
+{
+  GCtab *kt = fs->kt;
+  TValue *array = tvref(kt->array);
+  Node *node = noderef(kt->node);
+  BCReg idx = bc_d(ins);
+  MSize i;
+  if (bc_op(ins) == BC_ISNEN) {
+    for (i = 0; i < kt->asize; i++)
+      if (tvhaskslot(&array[i]) && tvkslot(&array[i]) == idx) {
+	setintV(o, (int32_t)i);
+	return;
+      }
+  }
+  for (i = 0; i <= kt->hmask; i++) {
+    Node *n = &node[i];
+    if (tvhaskslot(&n->val) && tvkslot(&n->val) == idx &&
+	(bc_op(ins) == BC_ISNEN ? tvisnum(&n->key) : tvisstr(&n->key))) {
+      copyTV(fs->L, o, &n->key);
+      return;
+    }
+  }
+  lua_assert(0);
+}
+
+/* Get integer key for the array part of the case table or -1. */
+static int32_t switch_intkey(cTValue *o, MSize ncase)
+{
+  if (tvisint(o)) {
+    int32_t k = intV(o);
+    if (k >= 0 && (MSize)k < 4*ncase) return k;
+  } else if (tvisnum(o)) {
+    lua_Number n = numV(o);
+    int32_t k = lj_num2int(n);
+    if (n == (lua_Number)k && k >= 0 && (MSize)k < 4*ncase) return k;
+  }
+  return -1;
+}
+
+/* Turn a chain of case tests into a multi-way branch.
+**
+** 'if v == k1 then ... elseif v == k2 then ...' compiles to a chain of
+** ISNES/ISNEN + JMP pairs. BC_SWITCH is inserted before the chain and looks
+** up string keys and small integer keys in a constant table. A hit jumps to
+** the first case for the key. Everything else falls through to the chain,
+** which is left untouched. This keeps all semantics (e.g. cdata keys) and
+** interpreters without a fast path may treat BC_SWITCH as a no-op.
+*/
+static void switch_emit(FuncState *fs, BCPos first, BCReg slot, MSize ncase)
+{
+  lua_State *L = fs->L;
+  GCtab *t;
+  TValue k;
+  BCPos pc;
+  MSize i, nstr = 0, nhit = 0;
+  int32_t kmax = -1;
+  for (i = 0, pc = first; i < ncase; i++, pc = jmp_next(fs, pc+1)) {
+    switch_key(fs, fs->bcbase[pc].ins, &k);
+    if (tvisstr(&k)) {
+      nstr++;
+    } else {
+      int32_t ik = switch_intkey(&k, ncase);
+      if (ik > kmax) kmax = ik;
+    }
+  }
+  /* No GC step until the table is anchored as a constant. */
+  t = lj_tab_new(L, (uint32_t)(kmax+1), hsize2hbits(nstr));
+  for (i = 0, pc = first; i < ncase; i++, pc = jmp_next(fs, pc+1)) {
+    TValue *o = NULL;
+    switch_key(fs, fs->bcbase[pc].ins, &k);
+    if (tvisstr(&k)) {
+      if (!lj_tab_getstr(t, strV(&k))) o = lj_tab_setstr(L, t, strV(&k));
+    } else {
+      int32_t ik = switch_intkey(&k, ncase);
+      if (ik >= 0 && tvisnil(arrayslot(t, ik))) o = arrayslot(t, ik);
+    }
+    if (o) {  /* Only the first case for a key matches. */
+      setintV(o, (int32_t)(pc+2-first));  /* Offset after BC_SWITCH. */
+      nhit++;
+    }
+  }
+  if (nhit >= SWITCH_MINCASE) {
+    BCReg kidx = const_gc(fs, obj2gco(t), LJ_TTAB);
+    bcemit_insert(fs, first, BCINS_AD(BC_SWITCH, slot, kidx));
+    lj_gc_check(L);
+  }
+}
+
 /* -- Blocks, loops and conditional statements ---------------------------- */
 
 /* Parse a block. */
@@ -2630,11 +2779,18 @@ static void parse_if(LexState *ls, BCLine line)
   FuncState *fs = ls->fs;
   BCPos flist;
   BCPos escapelist = NO_JMP;
+  BCPos first = fs->pc, pc;
+  BCReg slot = NO_REG;
+  MSize ncase, ntest = 1;
   flist = parse_then(ls);
+  ncase = (MSize)switch_iscase(fs, first, flist, &slot);
   while (ls->token == TK_elseif) {  /* Parse multiple 'elseif' blocks. */
     jmp_append(fs, &escapelist, bcemit_jmp(fs));
     jmp_tohere(fs, flist);
+    pc = fs->pc;
     flist = parse_then(ls);
+    if (ncase == ntest++ && switch_iscase(fs, pc, flist, &slot))
+      ncase++;
   }
   if (ls->token == TK_else) {  /* Parse optional 'else' block. */
     jmp_append(fs, &escapelist, bcemit_jmp(fs));
@@ -2645,6 +2801,8 @@ static void parse_if(LexState *ls, BCLine line)
     jmp_append(fs, &escapelist, flist);
   }
   jmp_tohere(fs, escapelist);
+  if (ncase >= SWITCH_MINCASE)
+    switch_emit(fs, first, slot, ncase);
   lex_match(ls, TK_end, TK_if, line);
 }
 
@@ -236,7 +236,8 @@ static void rec_stop(jit_State *J, TraceLink linktype, TraceNo lnk)
   J->cur.linktype = (uint8_t)linktype;
   J->cur.link = (uint16_t)lnk;
   /* Looping back at the same stack level? */
-  if (lnk == J->cur.traceno && J->framedepth + J->retdepth == 0) {
+  if (lnk == J->cur.traceno && J->framedepth + J->retdepth == 0 &&
+      linktype != LJ_TRLINK_ROOT) {
     if ((J->flags & JIT_F_OPT_LOOP))  /* Shall we try to create a loop? */
       goto nocanon;  /* Do not canonicalize or we lose the narrowing. */
     if (J->cur.root)  /* Otherwise ensure we always link to the root trace. */
@@ -535,6 +536,132 @@ static int innerloopleft(jit_State *J, const BCIns *pc)
   return 0;
 }
 
+/* Max. number of bytecodes of a fully unrolled FOR loop. */
+#define UNROLL_MAXBC	128
+
+/* Max. distance of a constant FOR loop from the code enclosing it. */
+#define KFORL_MAXSCAN	512
+
+/* Get the value of a constant FOR loop control variable. */
+static lua_Number rec_for_kval(jit_State *J, TRef tr)
+{
+  IRIns *ir = IR(tref_ref(tr));
+  return ir->o == IR_KINT ? (lua_Number)ir->i : ir_knum(ir)->n;
+}
+
+/* Check if a FOR loop can be fully unrolled.
+**
+** This is the case if all loop control variables are constants at this
+** point, e.g. 'for i=1,3 do'. The index then stays a constant, too, since
+** every increment is constant-folded. The remaining iterations times the
+** loop body must fit the budget. Nested loops are checked individually.
+*/
+static int rec_for_unroll(jit_State *J, const BCIns *fori)
+{
+  TRef *tr = &J->base[bc_a(*fori)];
+  if (tref_isk(tr[FORL_IDX]) && tref_isnumber(tr[FORL_IDX]) &&
+      tref_isk(tr[FORL_STOP]) && tref_isnumber(tr[FORL_STOP]) &&
+      tref_isk(tr[FORL_STEP]) && tref_isnumber(tr[FORL_STEP])) {
+    /* Upper bound for the remaining iterations. No need to round down. */
+    lua_Number step = rec_for_kval(J, tr[FORL_STEP]);
+    lua_Number n = (rec_for_kval(J, tr[FORL_STOP]) -
+		    rec_for_kval(J, tr[FORL_IDX])) / step + 1;
+    return step != 0 && n*(lua_Number)bc_j(*fori) <= UNROLL_MAXBC;
+  }
+  return 0;
+}
+
+/* Check if a FORL has small constant bounds, e.g. 'for i=1,3 do'.
+** Such a loop is unrolled by the trace of an enclosing loop, so it's not
+** worth to start a root trace for it. Only KSHORT operands are checked
+** and no jump may skip one of them, e.g. for 'for i=x and 1 or 2,3 do'.
+** The innermost enclosing loop or else the function itself must still be
+** able to start a trace, i.e. not compiled, blacklisted or failed before.
+** Otherwise neither would ever be compiled.
+**
+** This is checked on every hotcount event of the FORL. So only the body
+** of the enclosing loop or else the whole function is scanned, and only
+** up to KFORL_MAXSCAN bytecodes before and after the FOR loop.
+*/
+int lj_record_kforl(jit_State *J, const BCIns *forl)
+{
+  GCproto *pt = funcproto(curr_func(J->L));
+  const BCIns *bc = proto_bc(pt), *pc, *lpc = NULL;
+  const BCIns *lo = bc+1, *hi = bc+pt->sizebc;
+  const BCIns *fori = forl+bc_j(*forl);
+  BCReg ra = bc_a(*fori);
+  ptrdiff_t i;
+  if (fori-3 > bc &&
+      bc_op(fori[-1]) == BC_KSHORT && bc_a(fori[-1]) == ra+FORL_STEP &&
+      bc_op(fori[-2]) == BC_KSHORT && bc_a(fori[-2]) == ra+FORL_STOP &&
+      bc_op(fori[-3]) == BC_KSHORT && bc_a(fori[-3]) == ra+FORL_IDX) {
+    int32_t start = (int16_t)bc_d(fori[-3]);
+    int32_t stop = (int16_t)bc_d(fori[-2]);
+    int32_t step = (int16_t)bc_d(fori[-1]);
+    if (step == 0 || ((stop-start)/step + 1)*bc_j(*fori) > UNROLL_MAXBC)
+      return 0;
+  } else {
+    return 0;
+  }
+  /* Find the innermost enclosing loop, i.e. the first backward jump. */
+  for (pc = forl+1; pc < hi; pc++) {
+    BCOp op = bc_op(*pc);
+    const BCIns *target;
+    if (pc - fori > KFORL_MAXSCAN)
+      return 0;
+    if (op == BC_JFORL || op == BC_JITERL)
+      target = pc+bc_j(traceref(J, bc_d(*pc))->startins)+1;
+    else if (bcmode_d(op) == BCMjump)
+      target = pc+bc_j(*pc)+1;
+    else
+      continue;
+    if (target < fori) {
+      if (op == BC_JMP) {  /* Back to the condition of a while loop. */
+	const BCIns *lp;
+	for (lp = target; lp < fori; lp++)
+	  if (bc_op(*lp) == BC_LOOP) {
+	    lpc = lp;
+	    break;
+	  } else if (bc_op(*lp) == BC_ILOOP || bc_op(*lp) == BC_JLOOP) {
+	    return 0;
+	  }
+	if (!lpc) continue;
+      } else {
+	if (!(op == BC_FORL || (op == BC_ITERL && bc_op(pc[-1]) != BC_ITERN)))
+	  return 0;  /* No hotcount events for ITERN. */
+	lpc = pc;
+      }
+      lo = target;
+      hi = pc+1;
+      break;
+    }
+  }
+  if (!lpc) {  /* Otherwise a function trace of a fixarg function. */
+    if (bc_op(*bc) != BC_FUNCF)
+      return 0;
+    lpc = bc;
+  }
+  if (fori - lo > KFORL_MAXSCAN)
+    return 0;
+  /* Check all jumps of the enclosing loop body or function. */
+  for (pc = lo; pc < hi; pc++) {
+    BCOp op = bc_op(*pc);
+    const BCIns *target;
+    if (op == BC_JFORL || op == BC_JITERL)
+      target = pc+bc_j(traceref(J, bc_d(*pc))->startins)+1;
+    else if (bcmode_d(op) == BCMjump)
+      target = pc+bc_j(*pc)+1;
+    else
+      continue;
+    if (target == fori-2 || target == fori-1)
+      return 0;  /* Not all control variables are constant. */
+  }
+  for (i = 0; i < PENALTY_SLOTS; i++)
+    if (mref(J->penalty[i].pc, const BCIns) == lpc)
+      return 0;  /* Enclosing loop failed to trace. */
+  return 1;
+}
+
 /* Handle the case when an interpreted loop op is hit. */
 static void rec_loop_interp(jit_State *J, const BCIns *pc, LoopEvent ev)
 {
@@ -543,8 +670,13 @@ static void rec_loop_interp(jit_State *J, const BCIns *pc, LoopEvent ev)
       /* Same loop? */
       if (ev == LOOPEV_LEAVE)  /* Must loop back to form a root trace. */
 	lj_trace_err(J, LJ_TRERR_LLEAVE);
-      rec_stop(J, LJ_TRLINK_LOOP, J->cur.traceno);  /* Looping root trace. */
+      if (J->instunroll < 0)  /* Type-unstable loop? Link to own entry. */
+	rec_stop(J, LJ_TRLINK_ROOT, J->cur.traceno);
+      else
+	rec_stop(J, LJ_TRLINK_LOOP, J->cur.traceno);  /* Looping root trace. */
     } else if (ev != LOOPEV_LEAVE) {  /* Entering inner loop? */
+      if (bc_op(*pc) == BC_FORL && rec_for_unroll(J, pc+bc_j(*pc)))
+	return;  /* Fully unroll a short inner loop with constant bounds. */
       /* It's usually better to abort here and wait until the inner loop
       ** is traced. But if the inner loop repeatedly didn't loop back,
       ** this indicates a low trip count. In this case try unrolling
@@ -559,6 +691,8 @@ static void rec_loop_interp(jit_State *J, const BCIns *pc, LoopEvent ev)
       J->loopref = J->cur.nins;
     }
   } else if (ev != LOOPEV_LEAVE) {  /* Side trace enters an inner loop. */
+    if (bc_op(*pc) == BC_FORL && rec_for_unroll(J, pc+bc_j(*pc)))
+      return;  /* Fully unroll a short inner loop with constant bounds. */
     J->loopref = J->cur.nins;
     if (--J->loopunroll < 0)
       lj_trace_err(J, LJ_TRERR_LUNROLL);  /* Limit loop unrolling. */
@@ -572,8 +706,13 @@ static void rec_loop_jit(jit_State *J, TraceNo lnk, LoopEvent ev)
     /* Better let the inner loop spawn a side trace back here. */
     lj_trace_err(J, LJ_TRERR_LINNER);
   } else if (ev != LOOPEV_LEAVE) {  /* Side trace enters a compiled loop. */
+    GCtrace *T = traceref(J, lnk);
     J->instunroll = 0;  /* Cannot continue across a compiled loop op. */
-    if (J->pc == J->startpc && J->framedepth + J->retdepth == 0)
+    /* Don't form an extra loop for a type-unstable loop. Its root trace
+    ** links to its own entry and dispatches on the types there.
+    */
+    if (J->pc == J->startpc && J->framedepth + J->retdepth == 0 &&
+	!(T->linktype == LJ_TRLINK_ROOT && T->link == lnk))
       rec_stop(J, LJ_TRLINK_LOOP, J->cur.traceno);  /* Form an extra loop. */
     else
       rec_stop(J, LJ_TRLINK_ROOT, lnk);  /* Link to the loop. */
@@ -586,6 +725,8 @@ static void rec_loop_jit(jit_State *J, TraceNo lnk, LoopEvent ev)
 static TRef rec_call_specialize(jit_State *J, GCfunc *fn, TRef tr)
 {
   TRef kfunc;
+  if (tref_isk(tr))
+    return tr;  /* Already a constant, e.g. from a watched slot. */
   if (isluafunc(fn)) {
     GCproto *pt = funcproto(fn);
     /* Too many closures created? Probably not a monomorphic function. */
@@ -1075,6 +1216,15 @@ static void rec_idx_abc(jit_State *J, TRef asizeref, TRef ikey, uint32_t asize)
 	return;
       }
     }
+    /* Bounded key? Emit invariant bounds check for its upper limit. */
+    {
+      int32_t lo, hi;
+      lj_opt_narrow_range(J, tref_ref(ikey), &lo, &hi);
+      if (lo >= 0 && (uint32_t)hi < asize) {
+	emitir(IRTG(IR_ABC, IRT_P32), asizeref, lj_ir_kint(J, hi));
+	return;
+      }
+    }
   }
   emitir(IRTGI(IR_ABC), asizeref, ikey);  /* Emit regular bounds check. */
 }
@@ -1163,6 +1313,129 @@ static int nommstr(jit_State *J, TRef key)
   return 1;  /* CANNOT be a metamethod name. */
 }
 
+/* -- Watched table slots ------------------------------------------------- */
+
+/* Loads from watched slots of constant tables are turned into constants.
+** Writes from the interpreter or the C API flush the traces (see
+** lj_trace_watchset). Traces never store to a watched slot: stores to
+** constant tables are registered and those slots are never watched. Stores
+** to other tables check at runtime that the table has no watched slots.
+*/
+#if LJ_TARGET_X86ORX64
+#define rec_canwatch(J)		((J)->flags & JIT_F_OPT_WATCH)
+#else
+/* NYI: the interpreters for other targets don't check for watched slots. */
+#define rec_canwatch(J)		0
+#endif
+
+/* Find a watched table slot. */
+static WatchSlot *rec_watch_find(jit_State *J, GCtab *t, GCstr *key,
+				 uint32_t store)
+{
+  MSize i;
+  for (i = 0; i < J->nwatch; i++) {
+    WatchSlot *ws = &J->watch[i];
+    if (gcref(ws->key) == obj2gco(key) && ws->store == store &&
+	(gcref(ws->tab) == obj2gco(t) || (store && !gcref(ws->tab))))
+      return ws;
+  }
+  return NULL;
+}
+
+/* Check whether a key is watched in any table. */
+static int rec_watch_haskey(jit_State *J, GCstr *key)
+{
+  MSize i;
+  for (i = 0; i < J->nwatch; i++) {
+    WatchSlot *ws = &J->watch[i];
+    if (gcref(ws->key) == obj2gco(key) && !ws->store)
+      return 1;
+  }
+  return 0;
+}
+
+/* Add a watched table slot. Returns 0 if all slots are in use. */
+static int rec_watch_add(jit_State *J, GCtab *t, GCstr *key, uint32_t store)
+{
+  if (!rec_watch_find(J, t, key, store)) {
+    WatchSlot *ws;
+    if (J->nwatch >= WATCH_SLOTS)
+      return 0;
+    ws = &J->watch[J->nwatch++];
+    setgcref(ws->tab, obj2gco(t));
+    setgcref(ws->key, obj2gco(key));
+    ws->store = store;
+  }
+  return 1;
+}
+
+/* Watch a table slot. Returns its value or NULL if it can't be watched. */
+static cTValue *rec_watch_slot(jit_State *J, GCtab *t, GCstr *key)
+{
+  cTValue *tv;
+  if (!rec_canwatch(J) || (t->colo & LJ_COLO_NOWATCH))
+    return NULL;
+  tv = lj_tab_getstr(t, key);
+  /* Only watch functions and tables. Other values change too often. */
+  if (!tv || !(tvisfunc(tv) || tvistab(tv)) ||
+      rec_watch_find(J, t, key, 1) || !rec_watch_add(J, t, key, 0))
+    return NULL;
+  t->colo |= LJ_COLO_WATCH;
+  return tv;
+}
+
+/* Try to turn a load from a table slot into a constant. */
+static TRef rec_watch_load(jit_State *J, RecordIndex *ix)
+{
+  cTValue *tv;
+  if (!tref_isk(ix->tab) || !tref_isk(ix->key) || !tref_isstr(ix->key))
+    return 0;
+  tv = rec_watch_slot(J, tabV(&ix->tabv), ir_kstr(IR(tref_ref(ix->key))));
+  return tv ? lj_ir_kgc(J, gcV(tv), itype2irt(tv)) : 0;
+}
+
+/* Check a store to an existing table slot with a string key. */
+static void rec_watch_store(jit_State *J, RecordIndex *ix)
+{
+  GCtab *t = tabV(&ix->tabv);
+  if (!tref_isk(ix->tab)) {
+    IRIns *ir = IR(tref_ref(ix->tab));
+    TRef tr;
+    if (ir->o == IR_TNEW || ir->o == IR_TDUP)
+      return;  /* New tables have no watched slots. */
+    if (!(t->colo & LJ_COLO_WATCH)) {
+      /* Most keys are never watched, e.g. the fields of objects. Then
+      ** never watch the key of any table from now on and omit the check.
+      */
+      if (tref_isk(ix->key)) {
+	GCstr *key = ir_kstr(IR(tref_ref(ix->key)));
+	if (!rec_watch_haskey(J, key) && rec_watch_add(J, NULL, key, 1))
+	  return;
+      }
+      /* Otherwise check the table at runtime. */
+      tr = emitir(IRT(IR_FLOAD, IRT_U8), ix->tab, IRFL_TAB_COLO);
+      tr = emitir(IRTI(IR_BAND), tr, lj_ir_kint(J, LJ_COLO_WATCH));
+      emitir(IRTGI(IR_EQ), tr, lj_ir_kint(J, 0));
+      return;
+    }
+    /* Otherwise specialize to the table, e.g. a module table. */
+    tr = lj_ir_ktab(J, t);
+    emitir(IRTG(IR_EQ, IRT_TAB), ix->tab, tr);
+    ix->tab = tr;
+  }
+  if (!(t->colo & LJ_COLO_NOWATCH)) {
+    if (tref_isk(ix->key)) {
+      GCstr *key = ir_kstr(IR(tref_ref(ix->key)));
+      if (!rec_watch_find(J, t, key, 0) && rec_watch_add(J, t, key, 1))
+	return;  /* Never watch this slot from now on. */
+    }
+    t->colo |= LJ_COLO_NOWATCH;
+  }
+  /* Let the interpreter perform the store and flush the traces. */
+  if ((t->colo & LJ_COLO_WATCH))
+    lj_trace_err(J, LJ_TRERR_WATCHST);
+}
+
 /* Record indexed load/store. */
 TRef lj_record_idx(jit_State *J, RecordIndex *ix)
 {
@@ -1212,6 +1485,11 @@ TRef lj_record_idx(jit_State *J, RecordIndex *ix)
     }
   }
 
+  if (ix->val == 0) {  /* Load from a watched slot? */
+    TRef tr = rec_watch_load(J, ix);
+    if (tr) return tr;
+  }
+
   /* Record the key lookup. */
   xref = rec_idx_key(J, ix);
   xrefop = IR(tref_ref(xref))->o;
@@ -1235,6 +1513,9 @@ TRef lj_record_idx(jit_State *J, RecordIndex *ix)
   } else {  /* Indexed store. */
     GCtab *mt = tabref(tabV(&ix->tabv)->metatable);
     int keybarrier = tref_isgcv(ix->key) && !tref_isnil(ix->val);
+    /* Stores to existing string keys may hit watched slots. */
+    if (LJ_TARGET_X86ORX64 && tref_isstr(ix->key) && oldv != niltvg(J2G(J)))
+      rec_watch_store(J, ix);
     if (tvisnil(oldv)) {  /* Previous value was nil? */
       /* Need to duplicate the hasmm check for the early guards. */
       int hasmm = 0;
@@ -1294,6 +1575,17 @@ TRef lj_record_idx(jit_State *J, RecordIndex *ix)
 
 /* -- Upvalue access ------------------------------------------------------ */
 
+/* Check whether the next instruction loads a watchable slot of a table. */
+static int rec_upvalue_watch(jit_State *J, GCtab *t)
+{
+  BCIns ins = J->pc[1];
+  if (bc_op(ins) == BC_TGETS && bc_b(ins) == bc_a(*J->pc)) {
+    GCstr *key = gco2str(proto_kgc(J->pt, ~(ptrdiff_t)bc_c(ins)));
+    return rec_watch_slot(J, t, key) != NULL;
+  }
+  return 0;
+}
+
 /* Check whether upvalue is immutable and ok to constify. */
 static int rec_upvalue_constify(jit_State *J, GCupval *uvp)
 {
@@ -1315,6 +1607,9 @@ static int rec_upvalue_constify(jit_State *J, GCupval *uvp)
 #endif
     if (!(tvistab(o) || tvisudata(o) || tvisthread(o)))
       return 1;
+    /* But a module table etc. is needed to watch the slot loaded next. */
+    if (tvistab(o) && rec_upvalue_watch(J, tabV(o)))
+      return 1;
   }
   return 0;
 }
@@ -1462,6 +1757,56 @@ static void rec_func_vararg(jit_State *J)
   J->baseslot += vframe;
 }
 
+/* Max. # of modified slots held by callers of an inlined function. */
+#define CALLOUT_MAXLIVE		64
+
+/* Count modified slots of all callers. These need registers or spill slots. */
+static BCReg rec_func_live(jit_State *J)
+{
+  BCReg s, n = 0;
+  for (s = 0; s < J->baseslot; s++) {
+    TRef tr = J->slot[s];
+    if (tr && !tref_isk(tr)) {
+      IRIns *ir = IR(tref_ref(tr));
+      if (!(ir->o == IR_SLOAD && ir->op1 == s && !(ir->op2 & IRSLOAD_INHERIT)))
+	n++;
+    }
+  }
+  return n;
+}
+
+/* Check if inlining this function ran out of IR in an earlier attempt. */
+static int rec_func_overflow(jit_State *J)
+{
+  ptrdiff_t i;
+  for (i = 0; i < CALLOUT_SLOTS; i++)
+    if (mref(J->callout[i].pc, const BCIns) == J->pc &&
+	mref(J->callout[i].startpc, const BCIns) == J->startpc)
+      return 1;
+  return 0;
+}
+
+/* Check whether to leave a call to the interpreter instead of inlining it.
+**
+** Inlining a callee that can't be compiled or that would exceed the stack
+** slot or spill slot limits would abort the whole trace. Rather stop the
+** trace at the function entry and let the callee run in the interpreter
+** or in its own function trace. The same is done for a callee which ran
+** out of IR in an earlier attempt to record this trace.
+*/
+static int rec_func_callout(jit_State *J, BCReg vframe)
+{
+  GCproto *pt = J->pt;
+  if (J->pc != J->startpc &&
+      ((pt->flags & PROTO_NOJIT) ||
+       J->baseslot + vframe + pt->framesize >= LJ_MAX_JSLOTS ||
+       rec_func_live(J) > CALLOUT_MAXLIVE || rec_func_overflow(J))) {
+    rec_stop(J, LJ_TRLINK_INTERP, 0);
+    return 1;
+  }
+  return 0;
+}
+
 /* Record entry to a Lua function. */
 static void rec_func_lua(jit_State *J)
 {
@@ -1472,10 +1817,11 @@ static void rec_func_lua(jit_State *J)
 /* Record entry to an already compiled function. */
 static void rec_func_jit(jit_State *J, TraceNo lnk)
 {
-  GCtrace *T;
-  rec_func_setup(J);
-  T = traceref(J, lnk);
+  GCtrace *T = traceref(J, lnk);
   if (T->linktype == LJ_TRLINK_RETURN) {  /* Trace returns to interpreter? */
+    if (rec_func_callout(J, 0))
+      return;
+    rec_func_setup(J);
     check_call_unroll(J, lnk);
     /* Temporarily unpatch JFUNC* to continue recording across function. */
     J->patchins = *J->pc;
@@ -1483,6 +1829,7 @@ static void rec_func_jit(jit_State *J, TraceNo lnk)
     *J->patchpc = T->startins;
     return;
   }
+  rec_func_setup(J);
   J->instunroll = 0;  /* Cannot continue across a compiled function. */
   if (J->pc == J->startpc && J->framedepth + J->retdepth == 0)
     rec_stop(J, LJ_TRLINK_TAILREC, J->cur.traceno);  /* Extra tail-recursion. */
@@ -1640,6 +1987,32 @@ static void rec_comp_fixup(jit_State *J, const BCIns *pc, int cond)
   lj_snap_shrink(J);  /* Shrink last snapshot if possible. */
 }
 
+/* Record multi-way branch. Mirrors the lookup of the x86/x64 interpreter.
+** A hit only needs a single guard for the key. Otherwise nothing is emitted,
+** since the chain of tests following BC_SWITCH is recorded, anyway.
+*/
+static void rec_switch(jit_State *J, TRef ra, cTValue *rav, GCtab *t)
+{
+  cTValue *tv = NULL;
+  TRef kr = 0;
+  if (!LJ_TARGET_X86ORX64) return;  /* Other interpreters run the tests. */
+  if (tref_isstr(ra)) {
+    tv = lj_tab_getstr(t, strV(rav));
+    kr = lj_ir_kstr(J, strV(rav));
+  } else if (tref_isnumber(ra)) {
+    lua_Number n = numberVnum(rav);
+    int32_t k = lj_num2int(n);
+    if (n == (lua_Number)k && (MSize)k < t->asize) {
+      tv = arrayslot(t, k);
+      kr = lj_ir_kint(J, k);
+    }
+  }
+  if (tv && tvisnumber(tv)) {
+    lj_snap_add(J);  /* Exits retry the branch. */
+    lj_record_objcmp(J, ra, kr, rav, rav);
+  }
+}
+
 /* Record the next bytecode instruction (_before_ it's executed). */
 void lj_record_ins(jit_State *J)
 {
@@ -1942,6 +2315,11 @@ void lj_record_ins(jit_State *J)
   case BC_GGET: case BC_GSET:
     settabV(J->L, &ix.tabv, tabref(J->fn->l.env));
     ix.tab = emitir(IRT(IR_FLOAD, IRT_TAB), getcurrf(J), IRFL_FUNC_ENV);
+    if (rec_canwatch(J)) {  /* Specialize to the environment table. */
+      TRef kenv = lj_ir_ktab(J, tabV(&ix.tabv));
+      emitir(IRTG(IR_EQ, IRT_TAB), ix.tab, kenv);
+      ix.tab = kenv;
+    }
     ix.idxchain = LJ_MAX_IDXCHAIN;
     rc = lj_record_idx(J, &ix);
     break;
@@ -2054,18 +2432,25 @@ void lj_record_ins(jit_State *J)
       J->maxslot = ra;  /* Shrink used slots. */
     break;
 
+  case BC_SWITCH:
+    rec_switch(J, ra, rav, gco2tab(proto_kgc(J->pt, ~(ptrdiff_t)rc)));
+    break;
+
   /* -- Function headers -------------------------------------------------- */
 
   case BC_FUNCF:
-    rec_func_lua(J);
+    if (!rec_func_callout(J, 0))
+      rec_func_lua(J);
     break;
   case BC_JFUNCF:
     rec_func_jit(J, rc);
     break;
 
   case BC_FUNCV:
-    rec_func_vararg(J);
-    rec_func_lua(J);
+    if (!rec_func_callout(J, J->maxslot+1)) {
+      rec_func_vararg(J);
+      rec_func_lua(J);
+    }
     break;
   case BC_JFUNCV:
     lua_assert(0);  /* Cannot happen. No hotcall counting for varag funcs. */
@@ -2182,6 +2567,7 @@ void lj_record_setup(jit_State *J)
   J->loopunroll = J->param[JIT_P_loopunroll];
   J->tailcalled = 0;
   J->loopref = 0;
+  J->nrptr = 0;
 
   J->bc_min = NULL;  /* Means no limit. */
   J->bc_extent = ~(MSize)0;
@@ -21,6 +21,7 @@
 #include "lj_trace.h"
 #include "lj_snap.h"
 #include "lj_target.h"
+#include "lj_usdt.h"
 #if LJ_HASFFI
 #include "lj_ctype.h"
 #include "lj_cdata.h"
@@ -338,6 +339,71 @@ void lj_snap_shrink(jit_State *J)
   J->cur.nsnapmap = (uint32_t)(snap->mapofs + m);  /* Free up space in map. */
 }
 
+/* -- Snapshot map packing ------------------------------------------------ */
+
+/* Consecutive snapshots of a trace usually share most of their entries,
+** since the slots are sorted and only a few of them change inbetween.
+** The snapshot map of a saved trace is packed by replacing the longest
+** common prefix with the last unpacked (key) snapshot by a single entry:
+**
+**   SNAP(prefix length, SNAP_KEYREF, key snapshot number)
+**
+** The remaining entries, the PC and the frame links follow as usual, so
+** snap_nextofs() and the frame links at the end stay valid. A snapshot
+** map is only packed if it has at least one entry, which tells the marker
+** apart from a PC.
+*/
+
+/* Pack snapshot map of the current trace. Only computes the size, if
+** map is NULL. Otherwise updates the map offsets in snap, too.
+*/
+MSize lj_snap_packmap(jit_State *J, SnapShot *snap, SnapEntry *map)
+{
+  SnapShot *osnap = J->cur.snap;
+  SnapEntry *omap = J->cur.snapmap;
+  MSize i, nsnap = J->cur.nsnap, key = 0, ofs = 0;
+  for (i = 0; i < nsnap; i++) {
+    SnapEntry *m = &omap[osnap[i].mapofs];
+    MSize n = snap_nextofs(&J->cur, &osnap[i]) - osnap[i].mapofs;
+    MSize k = 0;
+    if (i > 0 && key <= 0xffff) {
+      SnapEntry *km = &omap[osnap[key].mapofs];
+      MSize kmax = osnap[key].nent < osnap[i].nent ?
+		   osnap[key].nent : osnap[i].nent;
+      while (k < kmax && m[k] == km[k]) k++;
+    }
+    if (map) snap[i].mapofs = (uint32_t)ofs;
+    if (k >= SNAP_MINPREFIX) {  /* Share prefix with key snapshot. */
+      if (map) {
+	map[ofs] = SNAP(k, SNAP_KEYREF, key);
+	memcpy(&map[ofs+1], m+k, (n-k)*sizeof(SnapEntry));
+      }
+      ofs += 1+n-k;
+    } else {  /* Otherwise store it unpacked and make it the new key. */
+      if (map) memcpy(&map[ofs], m, n*sizeof(SnapEntry));
+      ofs += n;
+      key = i;
+    }
+  }
+  return ofs;
+}
+
+/* Get snapshot map of a saved trace. Unpacks entries + PC into buf. */
+SnapEntry *lj_snap_map(GCtrace *T, SnapShot *snap, SnapEntry *buf)
+{
+  SnapEntry *map = &T->snapmap[snap->mapofs];
+  if (snap->nent > 0 && (map[0] & SNAP_KEYREF)) {
+    SnapShot *ksnap = &T->snap[snap_ref(map[0])];
+    MSize k = snap_slot(map[0]);
+    lua_assert(ksnap < snap && !(T->snapmap[ksnap->mapofs] & SNAP_KEYREF));
+    lua_assert(snap->nent < SNAP_MAXMAP);
+    memcpy(buf, &T->snapmap[ksnap->mapofs], k*sizeof(SnapEntry));
+    memcpy(buf+k, map+1, (snap->nent+1-k)*sizeof(SnapEntry));
+    return buf;
+  }
+  return map;
+}
+
 /* -- Snapshot access ----------------------------------------------------- */
 
 /* Initialize a Bloom Filter with all renamed refs.
@@ -368,7 +434,8 @@ static RegSP snap_renameref(GCtrace *T, SnapNo lim, IRRef ref, RegSP rs)
 IRIns *lj_snap_regspmap(GCtrace *T, SnapNo snapno, IRIns *ir)
 {
   SnapShot *snap = &T->snap[snapno];
-  SnapEntry *map = &T->snapmap[snap->mapofs];
+  SnapEntry buf[SNAP_MAXMAP];
+  SnapEntry *map = lj_snap_map(T, snap, buf);
   BloomFilter rfilt = snap_renamefilter(T, snapno);
   MSize n = 0;
   IRRef ref = 0;
@@ -466,7 +533,8 @@ static LJ_AINLINE int snap_sunk_store(GCtrace *T, IRIns *ira, IRIns *irs)
 void lj_snap_replay(jit_State *J, GCtrace *T)
 {
   SnapShot *snap = &T->snap[J->exitno];
-  SnapEntry *map = &T->snapmap[snap->mapofs];
+  SnapEntry buf[SNAP_MAXMAP];
+  SnapEntry *map = lj_snap_map(T, snap, buf);
   MSize n, nent = snap->nent;
   BloomFilter seen = 0;
   int pass23 = 0;
@@ -831,7 +899,8 @@ const BCIns *lj_snap_restore(jit_State *J, void *exptr)
   GCtrace *T = traceref(J, J->parent);
   SnapShot *snap = &T->snap[snapno];
   MSize n, nent = snap->nent;
-  SnapEntry *map = &T->snapmap[snap->mapofs];
+  SnapEntry buf[SNAP_MAXMAP];
+  SnapEntry *map = lj_snap_map(T, snap, buf);
   SnapEntry *flinks = &T->snapmap[snap_nextofs(T, snap)-1];
   int32_t ftsz0;
   TValue *frame;
@@ -839,6 +908,8 @@ const BCIns *lj_snap_restore(jit_State *J, void *exptr)
   const BCIns *pc = snap_pc(map[nent]);
   lua_State *L = J->L;
 
+  lj_usdt2(trace__exit, J->parent, snapno);
+
   /* Set interpreter PC to the next PC to get correct error messages. */
   setcframe_pc(cframe_raw(L->cframe), pc+1);
 
@@ -880,7 +951,7 @@ const BCIns *lj_snap_restore(jit_State *J, void *exptr)
       }
     }
   }
-  lua_assert(map + nent == flinks);
+  lua_assert(flinks >= &T->snapmap[snap->mapofs] && *flinks == map[nent]);
 
   /* Compute current stack top. */
   switch (bc_op(*pc)) {
@@ -13,6 +13,8 @@
 LJ_FUNC void lj_snap_add(jit_State *J);
 LJ_FUNC void lj_snap_purge(jit_State *J);
 LJ_FUNC void lj_snap_shrink(jit_State *J);
+LJ_FUNC MSize lj_snap_packmap(jit_State *J, SnapShot *snap, SnapEntry *map);
+LJ_FUNC SnapEntry *lj_snap_map(GCtrace *T, SnapShot *snap, SnapEntry *buf);
 LJ_FUNC IRIns *lj_snap_regspmap(GCtrace *T, SnapNo snapno, IRIns *ir);
 LJ_FUNC void lj_snap_replay(jit_State *J, GCtrace *T);
 LJ_FUNC const BCIns *lj_snap_restore(jit_State *J, void *exptr);
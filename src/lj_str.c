@@ -43,6 +43,26 @@ int32_t LJ_FASTCALL lj_str_cmp(GCstr *a, GCstr *b)
   return (int32_t)(a->len - b->len);
 }
 
+/* Find fixed string p inside string s. */
+const char *lj_str_find(const char *s, const char *p, MSize slen, MSize plen)
+{
+  if (plen <= slen) {
+    if (plen == 0) {
+      return s;
+    } else {
+      int c = *(const uint8_t *)p++;
+      plen--; slen -= plen;
+      while (slen) {
+	const char *q = (const char *)memchr(s, c, slen);
+	if (!q) break;
+	if (memcmp(q+1, p, plen) == 0) return q;
+	q++; slen -= (MSize)(q-s); s = q;
+      }
+    }
+  }
+  return NULL;
+}
+
 /* Fast string data comparison. Caveat: unaligned access to 1st string! */
 static LJ_AINLINE int str_fastcmp(const char *a, const char *b, MSize len)
 {
@@ -74,6 +94,22 @@ void lj_str_resize(lua_State *L, MSize newmask)
     return;  /* No resizing during GC traversal or if already too big. */
   newhash = lj_mem_newvec(L, newmask+1, GCRef);
   memset(newhash, 0, (newmask+1)*sizeof(GCRef));
+  if (LJ_UNLIKELY(g->gc.frozen)) {  /* Keep frozen strings at chain tails. */
+    for (i = g->strmask; i != ~(MSize)0; i--) {
+      GCRef *pp = &g->strhash[i];
+      GCobj *p;
+      while ((p = gcref(*pp)) != NULL) {
+	if (isfrozen(p)) {  /* Unlink and reinsert frozen strings first. */
+	  MSize h = gco2str(p)->hash & newmask;
+	  setgcrefr(*pp, p->gch.nextgc);
+	  setgcrefr(p->gch.nextgc, newhash[h]);
+	  setgcref(newhash[h], p);
+	} else {
+	  pp = &p->gch.nextgc;
+	}
+      }
+    }
+  }
   for (i = g->strmask; i != ~(MSize)0; i--) {  /* Rehash old table. */
     GCobj *p = gcref(g->strhash[i]);
     while (p) {  /* Follow each hash chain and reinsert all strings. */
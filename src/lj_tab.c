@@ -13,6 +13,7 @@
 #include "lj_gc.h"
 #include "lj_err.h"
 #include "lj_tab.h"
+#include "lj_trace.h"
 
 /* -- Object hashing ------------------------------------------------------ */
 
@@ -203,10 +204,10 @@ void LJ_FASTCALL lj_tab_free(global_State *g, GCtab *t)
 {
   if (t->hmask > 0)
     lj_mem_freevec(g, noderef(t->node), t->hmask+1, Node);
-  if (t->asize > 0 && LJ_MAX_COLOSIZE != 0 && t->colo <= 0)
+  if (t->asize > 0 && LJ_MAX_COLOSIZE != 0 && tabcolo(t) <= 0)
     lj_mem_freevec(g, tvref(t->array), t->asize, TValue);
-  if (LJ_MAX_COLOSIZE != 0 && t->colo)
-    lj_mem_free(g, t, sizetabcolo((uint32_t)t->colo & 0x7f));
+  if (LJ_MAX_COLOSIZE != 0 && tabcolo(t))
+    lj_mem_free(g, t, sizetabcolo((uint32_t)tabcolo(t) & 0x7f));
   else
     lj_mem_freet(g, t);
 }
@@ -224,7 +225,7 @@ static void resizetab(lua_State *L, GCtab *t, uint32_t asize, uint32_t hbits)
     uint32_t i;
     if (asize > LJ_MAX_ASIZE)
       lj_err_msg(L, LJ_ERR_TABOV);
-    if (LJ_MAX_COLOSIZE != 0 && t->colo > 0) {
+    if (LJ_MAX_COLOSIZE != 0 && tabcolo(t) > 0) {
       /* A colocated array must be separated and copied. */
       TValue *oarray = tvref(t->array);
       array = lj_mem_newvec(L, asize, TValue);
@@ -257,7 +258,7 @@ static void resizetab(lua_State *L, GCtab *t, uint32_t asize, uint32_t hbits)
       if (!tvisnil(&array[i]))
 	copyTV(L, lj_tab_setinth(L, t, (int32_t)i), &array[i]);
     /* Physically shrink only separated arrays. */
-    if (LJ_MAX_COLOSIZE != 0 && t->colo <= 0)
+    if (LJ_MAX_COLOSIZE != 0 && tabcolo(t) <= 0)
       setmref(t->array, lj_mem_realloc(L, array,
 	      oldasize*sizeof(TValue), asize*sizeof(TValue)));
   }
@@ -515,8 +516,11 @@ TValue *lj_tab_setstr(lua_State *L, GCtab *t, GCstr *key)
   TValue k;
   Node *n = hashstr(t, key);
   do {
-    if (tvisstr(&n->key) && strV(&n->key) == key)
+    if (tvisstr(&n->key) && strV(&n->key) == key) {
+      if (LJ_UNLIKELY(t->colo & LJ_COLO_WATCH))
+	lj_trace_watchset(L, t, key);
       return &n->val;
+    }
   } while ((n = nextnode(n)));
   setstrV(L, &k, key);
   return lj_tab_newkey(L, t, &k);
@@ -28,6 +28,7 @@
 #include "lj_asm.h"
 #include "lj_dispatch.h"
 #include "lj_vm.h"
+#include "lj_usdt.h"
 #include "lj_vmevent.h"
 #include "lj_target.h"
 
@@ -124,7 +125,7 @@ static GCtrace *trace_save_alloc(jit_State *J)
   size_t szins = (J->cur.nins-J->cur.nk)*sizeof(IRIns);
   size_t sz = sztr + szins +
 	      J->cur.nsnap*sizeof(SnapShot) +
-	      J->cur.nsnapmap*sizeof(SnapEntry);
+	      lj_snap_packmap(J, NULL, NULL)*sizeof(SnapEntry);
   return lj_mem_newt(J->L, (MSize)sz, GCtrace);
 }
 
@@ -143,7 +144,8 @@ static void trace_save(jit_State *J, GCtrace *T)
   memcpy(p, J->cur.ir+J->cur.nk, szins);
   p += szins;
   TRACE_APPENDVEC(snap, nsnap, SnapShot)
-  TRACE_APPENDVEC(snapmap, nsnapmap, SnapEntry)
+  T->snapmap = (SnapEntry *)p;
+  T->nsnapmap = (uint32_t)lj_snap_packmap(J, T->snap, T->snapmap);
   J->cur.traceno = 0;
   setgcrefp(J->trace[T->traceno], T);
   lj_gc_barriertrace(J2G(J), T->traceno);
@@ -227,6 +229,7 @@ static void trace_flushroot(jit_State *J, GCtrace *T)
 {
   GCproto *pt = &gcref(T->startpt)->pt;
   lua_assert(T->root == 0 && pt != NULL);
+  lj_usdt1(trace__flush, T->traceno);
   /* First unpatch any modified bytecode. */
   trace_unpatch(J, T);
   /* Unlink root trace from chain anchored in prototype. */
@@ -280,17 +283,56 @@ int lj_trace_flushall(lua_State *L)
   }
   J->cur.traceno = 0;
   J->freetrace = 0;
+  J->nwatch = J->watchmark = 0;  /* No more traces depend on watched slots. */
   /* Clear penalty cache. */
   memset(J->penalty, 0, sizeof(J->penalty));
+  memset(J->callout, 0, sizeof(J->callout));
   /* Free the whole machine code and invalidate all exit stub groups. */
   lj_mcode_free(J);
   memset(J->exitstubgroup, 0, sizeof(J->exitstubgroup));
+  lj_usdt0(trace__flushall);
   lj_vmevent_send(L, TRACE,
     setstrV(L, L->top++, lj_str_newlit(L, "flush"));
   );
   return 0;
 }
 
+/* Write to an existing slot of a table with watched slots.
+** Traces linked to the traces that treat the slot as a constant would
+** need to be flushed, too. Simply flush everything and never watch the
+** table again. This is rare, since only functions and tables are watched.
+**
+** Traces can't be flushed during __gc, which may run in the middle of
+** recording. Then only the bytecode of all root traces is unpatched, so
+** none of them can be entered anymore. This never throws.
+*/
+void lj_trace_watchset(lua_State *L, GCtab *t, GCstr *key)
+{
+  jit_State *J = L2J(L);
+  int hit = (t->colo & LJ_COLO_NOWATCH), live = 0;
+  MSize i;
+  for (i = 0; i < J->nwatch; i++) {
+    WatchSlot *ws = &J->watch[i];
+    if (gcref(ws->tab) == obj2gco(t) && !ws->store) {
+      live = 1;
+      if (gcref(ws->key) == obj2gco(key)) hit = 1;
+    }
+  }
+  if (!(hit && live)) {
+    if (!live) t->colo &= ~LJ_COLO_WATCH;  /* Lazily drop stale flag. */
+    return;
+  }
+  t->colo = (int8_t)((t->colo & ~LJ_COLO_WATCH) | LJ_COLO_NOWATCH);
+  lj_trace_abort(G(L));  /* The recorded trace may depend on the slot. */
+  if (lj_trace_flushall(L)) {
+    for (i = 1; i < J->sizetrace; i++) {
+      GCtrace *T = traceref(J, i);
+      if (T && T->root == 0 && i != J->cur.traceno)
+	trace_flushroot(J, T);
+    }
+  }
+}
+
 /* Initialize JIT compiler state. */
 void lj_trace_initstate(global_State *g)
 {
@@ -327,10 +369,63 @@ void lj_trace_freestate(global_State *g)
 /* -- Penalties and blacklisting ------------------------------------------ */
 
 /* Blacklist a bytecode instruction. */
-static void blacklist_pc(GCproto *pt, BCIns *pc)
+static void blacklist_pc(jit_State *J, GCproto *pt, BCIns *pc)
 {
+  BCPos pos = proto_bcpos(pt, pc);
+  uint32_t i, retry = 0, wait;
   setbc_op(pc, (int)bc_op(*pc)+(int)BC_ILOOP-(int)BC_LOOP);
   pt->flags |= PROTO_ILOOP;
+  if (J->param[JIT_P_cooldown] <= 0)
+    return;  /* Blacklisted for good. */
+  for (i = 0; i < BLACKLIST_SLOTS; i++)
+    if (gcref(J->blacklist[i].pt) == obj2gco(pt) &&
+	J->blacklist[i].pos == pos) {  /* Cache slot found? */
+      retry = J->blacklist[i].retry + 1;
+      if (retry > BLACKLIST_RETRY) {  /* Give up, if retrying didn't help. */
+	setgcrefnull(J->blacklist[i].pt);
+	return;
+      }
+      goto setslot;
+    }
+  /* Assign a new blacklist slot. */
+  i = J->blacklistslot;
+  J->blacklistslot = (J->blacklistslot + 1) & (BLACKLIST_SLOTS-1);
+  setgcref(J->blacklist[i].pt, obj2gco(pt));
+  J->blacklist[i].pos = pos;
+setslot:
+  wait = (uint32_t)J->param[JIT_P_cooldown] << retry;  /* Back off. */
+  J->blacklist[i].retry = (uint16_t)retry;
+  J->blacklist[i].wait = (uint16_t)(wait < 65535 ? wait : 65535);
+}
+
+/* Retry blacklisted bytecode instructions after their cooldown. */
+void lj_trace_cooldown(jit_State *J)
+{
+  uint32_t i;
+  if (J->state != LJ_TRACE_IDLE)
+    return;  /* Don't patch bytecode while recording. */
+  for (i = 0; i < BLACKLIST_SLOTS; i++) {
+    HotBlacklist *bl = &J->blacklist[i];
+    if (gcref(bl->pt) && bl->wait && --bl->wait == 0) {
+      GCproto *pt = gco2pt(gcref(bl->pt));
+      BCIns *pc = proto_bc(pt) + bl->pos;
+      BCOp op = bc_op(*pc);
+      if (!(pt->flags & PROTO_NOJIT) &&
+	  (op == BC_IFORL || op == BC_IITERL || op == BC_ILOOP ||
+	   op == BC_IFUNCF))
+	setbc_op(pc, (int)op+(int)BC_LOOP-(int)BC_ILOOP);
+    }
+  }
+}
+
+/* Drop the blacklist slots of a prototype which is about to be freed. */
+void lj_trace_forgetproto(global_State *g, GCproto *pt)
+{
+  jit_State *J = G2J(g);
+  uint32_t i;
+  for (i = 0; i < BLACKLIST_SLOTS; i++)
+    if (gcref(J->blacklist[i].pt) == obj2gco(pt))
+      setgcrefnull(J->blacklist[i].pt);
 }
 
 /* Penalize a bytecode instruction. */
@@ -343,7 +438,7 @@ static void penalty_pc(jit_State *J, GCproto *pt, BCIns *pc, TraceError e)
       val = ((uint32_t)J->penalty[i].val << 1) +
 	    LJ_PRNG_BITS(J, PENALTY_RNDBITS);
       if (val > PENALTY_MAX) {
-	blacklist_pc(pt, pc);  /* Blacklist it, if that didn't help. */
+	blacklist_pc(J, pt, pc);  /* Blacklist it, if that didn't help. */
 	return;
       }
       goto setpenalty;
@@ -358,6 +453,40 @@ setpenalty:
   hotcount_set(J2GG(J), pc+1, val);
 }
 
+/* -- Side exits ---------------------------------------------------------- */
+
+/* Check whether an error is due to an unsupported operation. */
+static int trace_isnyi(TraceError e)
+{
+  switch (e) {
+  case LJ_TRERR_NYIBC: case LJ_TRERR_CJITOFF: case LJ_TRERR_NYICF:
+  case LJ_TRERR_NYIFF: case LJ_TRERR_NYIFFU: case LJ_TRERR_NYIRETL:
+  case LJ_TRERR_NYITMIX: case LJ_TRERR_NYICONV: case LJ_TRERR_NYICALL:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+/* A side trace failed right at its first instruction with an unsupported
+** operation. Retrying won't help, since it'd start with the same
+** instruction and slot types again. Instead make the next exit compile a
+** stub side trace, which restores the stack slots from registers/spill
+** slots and falls back to the interpreter. Other errors, e.g. a full trace
+** or mcode buffer, may go away, so these exits are retried as usual.
+*/
+static void trace_exitstub(jit_State *J)
+{
+  GCtrace *T = traceref(J, J->parent);
+  if (T) {
+    SnapShot *snap = &T->snap[J->exitno];
+    int32_t count = J->param[JIT_P_hotexit] + J->param[JIT_P_tryside] - 1;
+    if (snap->count != SNAPCOUNT_DONE && snap->count < count &&
+	count < SNAPCOUNT_DONE)
+      snap->count = (uint8_t)count;
+  }
+}
+
 /* -- Trace compiler state machine ---------------------------------------- */
 
 /* Start tracing. */
@@ -387,6 +516,7 @@ static void trace_start(jit_State *J)
     return;
   }
   setgcrefp(J->trace[traceno], &J->cur);
+  J->watchmark = J->nwatch;
 
   /* Setup enough of the current trace to be able to send the vmevent. */
   memset(&J->cur, 0, sizeof(GCtrace));
@@ -414,6 +544,9 @@ static void trace_start(jit_State *J)
       setintV(L->top++, J->exitno);
     }
   );
+  lj_usdt5(trace__start, traceno, J->parent, J->exitno,
+	   strdata(proto_chunkname(J->pt)),
+	   lj_debug_line(J->pt, proto_bcpos(J->pt, J->pc)));
   lj_record_setup(J);
 }
 
@@ -474,6 +607,7 @@ static void trace_stop(jit_State *J)
   lj_mcode_commit(J, J->cur.mcode);
   J->postproc = LJ_POST_NONE;
   trace_save(J, T);
+  lj_usdt4(trace__stop, traceno, T->linktype, T->link, T->szmcode);
 
   L = J->L;
   lj_vmevent_send(L, TRACE,
@@ -516,9 +650,20 @@ static int trace_abort(jit_State *J)
   /* Penalize or blacklist starting bytecode instruction. */
   if (J->parent == 0 && !bc_isret(bc_op(J->cur.startins)))
     penalty_pc(J, &gcref(J->cur.startpt)->pt, mref(J->cur.startpc, BCIns), e);
+  else if (J->parent != 0 && J->pc == mref(J->cur.startpc, BCIns) &&
+	   trace_isnyi(e))
+    trace_exitstub(J);
+  /* Stop at the entry of the inlined function where the IR ran out. */
+  if (e == LJ_TRERR_TRACEOV && J->framedepth > 0 && J->pt) {
+    uint32_t i = J->calloutslot;
+    J->calloutslot = (J->calloutslot + 1) & (CALLOUT_SLOTS-1);
+    setmref(J->callout[i].startpc, mref(J->cur.startpc, BCIns));
+    setmref(J->callout[i].pc, proto_bc(J->pt));
+  }
 
   /* Is there anything to abort? */
   traceno = J->cur.traceno;
+  lj_usdt2(trace__abort, traceno, e);
   if (traceno) {
     ptrdiff_t errobj = savestack(L, L->top-1);  /* Stack may be resized. */
     J->cur.link = 0;
@@ -544,6 +689,7 @@ static int trace_abort(jit_State *J)
     );
     /* Drop aborted trace after the vmevent (which may still access it). */
     setgcrefnull(J->trace[traceno]);
+    J->nwatch = J->watchmark;  /* Drop the slots watched by the trace. */
     if (traceno < J->freetrace)
       J->freetrace = traceno;
     J->cur.traceno = 0;
@@ -605,7 +751,8 @@ static TValue *trace_state(lua_State *L, lua_CFunction dummy, void *ud)
       trace_pendpatch(J, 1);
       J->loopref = 0;
       if ((J->flags & JIT_F_OPT_LOOP) &&
-	  J->cur.link == J->cur.traceno && J->framedepth + J->retdepth == 0) {
+	  J->cur.link == J->cur.traceno && J->cur.linktype != LJ_TRLINK_ROOT &&
+	  J->framedepth + J->retdepth == 0) {
 	setvmstate(J2G(J), OPT);
 	lj_opt_dce(J);
 	if (lj_opt_loop(J)) {  /* Loop optimization failed? */
@@ -668,9 +815,12 @@ void LJ_FASTCALL lj_trace_hot(jit_State *J, const BCIns *pc)
   ERRNO_SAVE
   /* Reset hotcount. */
   hotcount_set(J2GG(J), pc, J->param[JIT_P_hotloop]*HOTCOUNT_LOOP);
-  /* Only start a new trace if not recording or inside __gc call or vmevent. */
+  /* Only start a new trace if not recording or inside __gc call or vmevent.
+  ** Small constant loops are left for the trace of an enclosing loop.
+  */
   if (J->state == LJ_TRACE_IDLE &&
-      !(J2G(J)->hookmask & (HOOK_GC|HOOK_VMEVENT))) {
+      !(J2G(J)->hookmask & (HOOK_GC|HOOK_VMEVENT)) &&
+      !(bc_op(pc[-1]) == BC_FORL && lj_record_kforl(J, pc-1))) {
     J->parent = 0;  /* Root trace. */
     J->exitno = 0;
     J->state = LJ_TRACE_START;
@@ -0,0 +1,104 @@
+/*
+** Static user-space probes (USDT) for VM events.
+** Copyright (C) 2005-2021 Mike Pall. See Copyright Notice in luajit.h
+*/
+
+#ifndef _LJ_USDT_H
+#define _LJ_USDT_H
+
+#include "lj_def.h"
+
+/* This is not compiled in by default.
+** Enable with -DLUAJIT_USE_SYSTEMTAP in the Makefile and recompile everything.
+**
+** Each probe site is a single NOP plus a SystemTap-style SDT note in the
+** .note.stapsdt section, which is never loaded. There's no semaphore, so
+** an unused probe costs nothing but the NOP and the argument setup.
+** The notes are emitted directly, so <sys/sdt.h> is not needed.
+**
+** All arguments are passed as signed pointer-sized integers. Probes are
+** named with the usual DTrace convention ("__" reads as "-"), e.g.:
+**
+**   bpftrace -e 'usdt:./luajit:luajit:trace__abort { @[arg1] = count(); }'
+**
+** Probe               Arguments
+** gc__start           gc.total, gc.threshold
+** gc__atomic          gc.total
+** gc__end             gc.total, gc.estimate
+** trace__start        traceno, parent, exitno, chunkname, line
+** trace__stop         traceno, linktype, link, szmcode
+** trace__abort        traceno, error code (LJ_TRERR_*)
+** trace__flush        traceno (root trace)
+** trace__flushall     (none)
+** trace__exit         traceno, exitno
+*/
+#if defined(LUAJIT_USE_SYSTEMTAP) && defined(__GNUC__) && defined(__ELF__)
+
+#if LJ_64
+#define LJ_USDT_ADDR		".8byte"
+#define LJ_USDT_ASZ		"-8@"
+#else
+#define LJ_USDT_ADDR		".4byte"
+#define LJ_USDT_ASZ		"-4@"
+#endif
+
+#define LJ_USDT_A(n)		LJ_USDT_ASZ "%[a" #n "]"
+#define LJ_USDT_OP(n, x)	[a##n] "nor" ((intptr_t)(x))
+
+#define LJ_USDT_NOTE(name, args) \
+  "990: nop\n" \
+  ".pushsection .note.stapsdt,\"?\",\"note\"\n" \
+  ".balign 4\n" \
+  ".4byte 992f-991f, 994f-993f, 3\n" \
+  "991: .asciz \"stapsdt\"\n" \
+  "992: .balign 4\n" \
+  "993: " LJ_USDT_ADDR " 990b\n" \
+  LJ_USDT_ADDR " _.stapsdt.base\n" \
+  LJ_USDT_ADDR " 0\n" \
+  ".asciz \"luajit\"\n" \
+  ".asciz \"" #name "\"\n" \
+  ".asciz \"" args "\"\n" \
+  "994: .balign 4\n" \
+  ".popsection\n" \
+  ".ifndef _.stapsdt.base\n" \
+  ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n" \
+  ".weak _.stapsdt.base\n" \
+  ".hidden _.stapsdt.base\n" \
+  "_.stapsdt.base: .space 1\n" \
+  ".size _.stapsdt.base, 1\n" \
+  ".popsection\n" \
+  ".endif\n"
+
+#define lj_usdt0(name) \
+  __asm__ __volatile__(LJ_USDT_NOTE(name, "") ::)
+#define lj_usdt1(name, x1) \
+  __asm__ __volatile__(LJ_USDT_NOTE(name, LJ_USDT_A(1)) \
+    :: LJ_USDT_OP(1, x1))
+#define lj_usdt2(name, x1, x2) \
+  __asm__ __volatile__(LJ_USDT_NOTE(name, LJ_USDT_A(1) " " LJ_USDT_A(2)) \
+    :: LJ_USDT_OP(1, x1), LJ_USDT_OP(2, x2))
+#define lj_usdt3(name, x1, x2, x3) \
+  __asm__ __volatile__(LJ_USDT_NOTE(name, LJ_USDT_A(1) " " LJ_USDT_A(2) \
+					  " " LJ_USDT_A(3)) \
+    :: LJ_USDT_OP(1, x1), LJ_USDT_OP(2, x2), LJ_USDT_OP(3, x3))
+#define lj_usdt4(name, x1, x2, x3, x4) \
+  __asm__ __volatile__(LJ_USDT_NOTE(name, LJ_USDT_A(1) " " LJ_USDT_A(2) \
+					  " " LJ_USDT_A(3) " " LJ_USDT_A(4)) \
+    :: LJ_USDT_OP(1, x1), LJ_USDT_OP(2, x2), LJ_USDT_OP(3, x3), \
+       LJ_USDT_OP(4, x4))
+#define lj_usdt5(name, x1, x2, x3, x4, x5) \
+  __asm__ __volatile__(LJ_USDT_NOTE(name, LJ_USDT_A(1) " " LJ_USDT_A(2) \
+			  " " LJ_USDT_A(3) " " LJ_USDT_A(4) " " LJ_USDT_A(5)) \
+    :: LJ_USDT_OP(1, x1), LJ_USDT_OP(2, x2), LJ_USDT_OP(3, x3), \
+       LJ_USDT_OP(4, x4), LJ_USDT_OP(5, x5))
+
+#else
+#define lj_usdt0(name)				((void)0)
+#define lj_usdt1(name, x1)			((void)0)
+#define lj_usdt2(name, x1, x2)			((void)0)
+#define lj_usdt3(name, x1, x2, x3)		((void)0)
+#define lj_usdt4(name, x1, x2, x3, x4)		((void)0)
+#define lj_usdt5(name, x1, x2, x3, x4, x5)	((void)0)
+#endif
+
+#endif
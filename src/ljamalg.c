@@ -50,6 +50,7 @@
 #include "lj_bcread.c"
 #include "lj_bcwrite.c"
 #include "lj_load.c"
+#include "lj_image.c"
 #include "lj_ctype.c"
 #include "lj_cdata.c"
 #include "lj_cconv.c"
@@ -64,6 +64,27 @@ enum {
 /* Control the JIT engine. */
 LUA_API int luaJIT_setmode(lua_State *L, int idx, int mode);
 
+/* Interned keys for fast field access. Valid until the state is closed. */
+typedef struct luaJIT_Key luaJIT_Key;
+
+LUA_API const luaJIT_Key *luaJIT_key(lua_State *L, const char *k);
+LUA_API void luaJIT_getfieldk(lua_State *L, int idx, const luaJIT_Key *k);
+LUA_API void luaJIT_setfieldk(lua_State *L, int idx, const luaJIT_Key *k);
+
+/* Batched stack and table operations. */
+LUA_API void luaJIT_pushstrings(lua_State *L, const char *const *s,
+				const size_t *len, int n);
+LUA_API void luaJIT_pushnumarray(lua_State *L, const lua_Number *v, int n);
+LUA_API void luaJIT_pushstrarray(lua_State *L, const char *const *s,
+				 const size_t *len, int n);
+LUA_API void luaJIT_setfields(lua_State *L, int idx, const char *const *k,
+			      int n);
+LUA_API int luaJIT_tonumarray(lua_State *L, int idx, lua_Number *buf, int n);
+
+/* Heap images of the loaded modules. Returns a status like lua_load. */
+LUA_API int luaJIT_dumpimage(lua_State *L, lua_Writer writer, void *data);
+LUA_API int luaJIT_loadimage(lua_State *L, const char *buf, size_t size);
+
 /* Enforce (dynamic) linker error for version mismatches. Call from main. */
 LUA_API void LUAJIT_VERSION_SYM(void);
 
@@ -0,0 +1,30 @@
+-- Bytecode dumps only use the extended version if they contain BC_SWITCH.
+-- Run with: make check
+
+local function chain(x)
+  if x == 1 then return 1 elseif x == 2 then return 2
+  elseif x == 3 then return 3 elseif x == 4 then return 4
+  elseif x == 5 then return 5 elseif x == "six" then return 6 end
+  return 0
+end
+
+assert(string.dump(function(x) return chain(x) end):byte(4) == 1)
+assert(string.dump(chain):byte(4) == 0x80)
+-- A SWITCH in a child prototype also needs the extended version.
+assert(string.dump(function()
+  return function(x)
+    if x == 1 then return 1 elseif x == 2 then return 2
+    elseif x == 3 then return 3 elseif x == 4 then return 4
+    elseif x == 5 then return 5 elseif x == 6 then return 6 end
+  end
+end):byte(4) == 0x80)
+
+local f = loadstring(string.dump(chain))
+for i, k in ipairs{1, 2, 3, 4, 5, "six"} do assert(f(k) == i) end
+assert(f(7) == 0 and f("1") == 0)
+
+local out = {}
+require("jit.bc").dump(f, {
+  write = function(_, s) out[#out+1] = s end, flush = function() end
+})
+assert(table.concat(out):find('SWITCH.-; 1=>0004 2=>0009 .- "six"=>0029'))
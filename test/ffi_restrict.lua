@@ -0,0 +1,37 @@
+-- Accesses through the same restrict-qualified pointer object must alias.
+-- Run with: make check
+
+local ok, ffi = pcall(require, "ffi")
+if not ok then return end  -- Built without FFI.
+
+local function f(a, b, n)
+  local s = 0
+  for i=1,n do a[0] = i; s = s + b[0] end
+  return s
+end
+
+local p = ffi.cast("double *restrict", ffi.new("double[4]"))
+local q = ffi.cast("double *restrict", ffi.new("double[4]"))
+for k=1,100 do assert(f(p, p, 100) == 5050) end
+q[0] = 0
+for k=1,100 do assert(f(p, q, 100) == 0) end
+for k=1,100 do assert(f(p, p, 100) == 5050) end
+
+-- Same objects in different iterations of a loop.
+local function g(x, y, n)
+  local s, a, b = 0, x, y
+  for i=1,n do
+    a[0] = i; s = s + b[0]
+    a, b = b, a
+  end
+  return s
+end
+
+jit.off(g)
+p[0] = 0; q[0] = 0
+local ref = g(p, q, 100)
+jit.on(g)
+for k=1,100 do
+  p[0] = 0; q[0] = 0
+  assert(g(p, q, 100) == ref)
+end
@@ -0,0 +1,41 @@
+-- Side traces failing at their first instruction with an unsupported
+-- operation get a stub right away. Other errors are retried as usual.
+-- Run with: make check
+
+local function sidetraces(f)
+  local res = {}
+  jit.attach(function(what, tr, func, pc, otr, oex)
+    if what == "start" and otr then res[#res+1] = "start"
+    elseif what == "abort" and #res > 0 then res[#res+1] = "abort"
+    elseif what == "stop" and #res > 0 then res[#res+1] = "stop" end
+  end, "trace")
+  f()
+  jit.attach(function() end)
+  return table.concat(res, " ")
+end
+
+local function nyi(n)
+  local s = 0
+  for i=1,n do
+    if i > 100 then local f = function() end; s = s + 2 else s = s + 1 end
+  end
+  return s
+end
+local function ok(n)
+  local s = 0
+  for i=1,n do
+    if i > 100 then s = s + 2 else s = s + 1 end
+  end
+  return s
+end
+
+-- Unsupported operation: the side trace starts with a closure (FNEW).
+nyi(100)
+assert(sidetraces(function() nyi(300) end) == "start abort start stop")
+
+-- Other error: the side trace gets too long.
+ok(100)
+jit.opt.start("maxrecord=1")
+local ev = sidetraces(function() ok(300) end)
+jit.opt.start("maxrecord=4000")
+assert(ev == "start abort start abort start abort start abort start stop")
@@ -0,0 +1,22 @@
+-- Truncated or corrupted heap images must be rejected before any object
+-- or bytecode is read.
+-- Run with: make check
+
+local M = {f = function(x) return x * 2 end, t = {1, 2, "three"}}
+package.loaded.imgmod = M
+local img = jit.dumpimage()
+package.loaded.imgmod = nil
+
+for n = 0, #img-1 do
+  assert(not pcall(jit.loadimage, img:sub(1, n)), "truncated to "..n)
+end
+math.randomseed(1)
+for n = 1, 2000 do
+  local i = math.random(#img)
+  local c = string.char((img:byte(i) + math.random(255)) % 256)
+  local s = img:sub(1, i-1)..c..img:sub(i+1)
+  assert(not pcall(jit.loadimage, s), "corrupted at "..i)
+end
+
+assert(pcall(jit.loadimage, img))
+assert(package.loaded.imgmod.f(21) == 42)
@@ -0,0 +1,44 @@
+-- Stores to watched global slots from __gc must not throw and must
+-- invalidate the traces which treat the slot as a constant.
+-- Run with: make check
+
+function G(i) return i end
+local function run()
+  local s = 0
+  for i=1,200 do s = s + G(i) end
+  return s
+end
+assert(run() == 20100)
+assert(run() == 20100)
+
+do
+  local p = newproxy(true)
+  getmetatable(p).__gc = function() G = function(i) return 2*i end end
+end
+collectgarbage(); collectgarbage()
+assert(run() == 40200)
+
+do
+  local p = newproxy(true)
+  getmetatable(p).__gc = function()
+    pcall(function() G = function(i) return 3*i end end)
+  end
+end
+collectgarbage(); collectgarbage()
+assert(run() == 60300)
+
+-- Finalizers run while traces are recorded and executed.
+local function mk(k) return function(i) return k*i end end
+K = 1
+G = mk(1)
+local n = 0
+for r=1,2000 do
+  local p = newproxy(true)
+  getmetatable(p).__gc = function() n = n + 1; K = n % 7 + 1; G = mk(K) end
+  local t = {}
+  for i=1,50 do
+    t[i] = {i}
+    assert(G(i) == K*i)
+  end
+end
+assert(n > 0)
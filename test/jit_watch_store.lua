@@ -0,0 +1,36 @@
+-- Stores in traces to tables which are not constant must not change the
+-- slots that other traces treat as constants.
+-- Run with: make check
+
+local M = {f = function(x) return x + 1 end, g = function(x) return x + 1 end}
+local function runf()
+  local s = 0
+  for i=1,200 do s = s + M.f(i) end
+  return s
+end
+local function rung()
+  local s = 0
+  for i=1,200 do s = s + M.g(i) end
+  return s
+end
+local function setf(list, f)
+  for i=1,#list do list[i].f = f end
+end
+local function setg(list, f)
+  for i=1,#list do list[i].g = f end
+end
+
+local obj, list = {f = false, g = false}, {}
+for i=1,200 do list[i] = obj end
+jit.flush()
+-- The key is stored to first. M.f must not become a constant.
+setf(list, runf)
+assert(runf() == 20300)
+-- The key is watched first. The store must check the table.
+assert(rung() == 20300)
+setg(list, rung)
+list[200] = M
+setf(list, function(x) return x + 2 end)
+assert(runf() == 20500)
+setg(list, function(x) return x + 3 end)
+assert(rung() == 20700)
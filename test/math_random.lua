@@ -0,0 +1,37 @@
+-- Traces must produce the same PRNG sequence as the interpreter.
+-- Run with: make check
+
+local function run(seed)
+  math.randomseed(seed)
+  local a = {}
+  for i=1,300 do a[i] = math.random() end
+  for i=301,600 do a[i] = math.random(100) end
+  for i=601,900 do a[i] = math.random(-5, 5) end
+  local b = {}
+  math.randomfill(b, 100)
+  for i=1,100 do a[900+i] = b[i] end
+  return a
+end
+
+for _, seed in ipairs{0, 1, 42, 12345} do
+  jit.off(run)
+  local a = run(seed)
+  jit.on(run)
+  jit.flush()
+  local b = run(seed)
+  for i=1,#a do
+    assert(a[i] == b[i], "seed "..seed..": mismatch at "..i)
+  end
+end
+
+-- Dumping traces with the inlined PRNG step must work, with or without FFI.
+do
+  local dump = require("jit.dump")
+  local out = os.tmpname()
+  jit.flush()
+  dump.on("tbimsrx", out)
+  local s = 0
+  for i=1,1000 do s = s + math.random() end
+  dump.off()
+  os.remove(out)
+end